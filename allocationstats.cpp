@@ -0,0 +1,189 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "allocationstats.h"
+
+#ifdef MALIIT_ALLOCATION_STATS
+#include <QMutex>
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    const int MaxMessageTypes(64);
+
+    // Plain data only: these are touched from inside operator new.
+    struct Slot
+    {
+        const char *messageType;
+        quint64 messages;
+        quint64 allocations;
+        quint64 bytes;
+    };
+
+    Slot messageSlots[MaxMessageTypes];
+    int slotCount = 0;
+    QBasicMutex messageSlotsMutex;
+
+    thread_local Maliit::InputContext::AllocationScope *currentScope = 0;
+
+    void *countedAllocation(std::size_t size)
+    {
+        if (currentScope) {
+            ++currentScope->allocations;
+            currentScope->bytes += size;
+        }
+
+        void *memory = std::malloc(size ? size : 1);
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    return countedAllocation(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return countedAllocation(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+#endif
+
+namespace Maliit {
+namespace InputContext {
+
+#ifdef MALIIT_ALLOCATION_STATS
+AllocationScope::AllocationScope(const char *messageType)
+    : allocations(0)
+    , bytes(0)
+    , mMessageType(messageType)
+    , mOutermost(currentScope == 0)
+{
+    if (mOutermost) {
+        currentScope = this;
+    }
+}
+
+AllocationScope::~AllocationScope()
+{
+    if (!mOutermost) {
+        return;
+    }
+    currentScope = 0;
+
+    QMutexLocker locker(&messageSlotsMutex);
+    Slot *slot = 0;
+    for (int i = 0; i < slotCount && !slot; ++i) {
+        if (qstrcmp(messageSlots[i].messageType, mMessageType) == 0) {
+            slot = &messageSlots[i];
+        }
+    }
+    if (!slot) {
+        if (slotCount == MaxMessageTypes) {
+            return;
+        }
+        slot = &messageSlots[slotCount++];
+        slot->messageType = mMessageType;
+        slot->messages = slot->allocations = slot->bytes = 0;
+    }
+
+    ++slot->messages;
+    slot->allocations += allocations;
+    slot->bytes += bytes;
+}
+#endif
+
+namespace AllocationStatistics {
+
+bool enabled()
+{
+#ifdef MALIIT_ALLOCATION_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+QList<Entry> entries()
+{
+    QList<Entry> result;
+#ifdef MALIIT_ALLOCATION_STATS
+    Slot snapshot[MaxMessageTypes];
+    int count;
+    {
+        QMutexLocker locker(&messageSlotsMutex);
+        count = slotCount;
+        for (int i = 0; i < count; ++i) {
+            snapshot[i] = messageSlots[i];
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        Entry entry = { snapshot[i].messageType, snapshot[i].messages,
+                        snapshot[i].allocations, snapshot[i].bytes };
+        result.append(entry);
+    }
+#endif
+    return result;
+}
+
+QString report()
+{
+    if (!enabled()) {
+        return QString::fromLatin1("allocation statistics not compiled in (MALIIT_ALLOCATION_STATS)\n");
+    }
+
+    QString result = QString::fromLatin1("%1 %2 %3 %4\n")
+            .arg(QString::fromLatin1("message"), -32)
+            .arg(QString::fromLatin1("count"), 10)
+            .arg(QString::fromLatin1("allocs/msg"), 12)
+            .arg(QString::fromLatin1("bytes/msg"), 12);
+
+    Q_FOREACH (const Entry &entry, entries()) {
+        const double messages = entry.messages ? entry.messages : 1;
+        result += QString::fromLatin1("%1 %2 %3 %4\n")
+                .arg(QString::fromLatin1(entry.messageType), -32)
+                .arg(entry.messages, 10)
+                .arg(entry.allocations / messages, 12, 'f', 1)
+                .arg(entry.bytes / messages, 12, 'f', 1);
+    }
+    return result;
+}
+
+void reset()
+{
+#ifdef MALIIT_ALLOCATION_STATS
+    QMutexLocker locker(&messageSlotsMutex);
+    slotCount = 0;
+#endif
+}
+
+} // namespace AllocationStatistics
+
+} // namespace InputContext
+} // namespace Maliit
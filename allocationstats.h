@@ -0,0 +1,76 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_ALLOCATIONSTATS_H
+#define MALIIT_INPUTCONTEXT_ALLOCATIONSTATS_H
+
+#include <QList>
+#include <QString>
+
+namespace Maliit {
+namespace InputContext {
+
+/*! \brief Attributes heap allocations made while it lives to \a messageType.
+ *
+ * Only does something in builds with MALIIT_ALLOCATION_STATS defined, which
+ * replace the global allocation operators to count allocations.  Scopes nested
+ * in another one are accounted to the outermost scope, so the cost of a
+ * message includes every hop it takes through the library.
+ */
+#ifdef MALIIT_ALLOCATION_STATS
+class AllocationScope
+{
+public:
+    explicit AllocationScope(const char *messageType);
+    ~AllocationScope();
+
+    quint64 allocations;
+    quint64 bytes;
+
+private:
+    Q_DISABLE_COPY(AllocationScope)
+
+    const char *mMessageType;
+    bool mOutermost;
+};
+#else
+class AllocationScope
+{
+public:
+    explicit AllocationScope(const char *) {}
+};
+#endif
+
+namespace AllocationStatistics {
+
+struct Entry
+{
+    const char *messageType;
+    quint64 messages;
+    quint64 allocations;
+    quint64 bytes;
+};
+
+//! \brief Whether this build counts allocations at all
+bool enabled();
+QList<Entry> entries();
+//! \brief Text table of allocations and bytes per message, by message type
+QString report();
+void reset();
+
+} // namespace AllocationStatistics
+
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_ALLOCATIONSTATS_H
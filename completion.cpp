@@ -0,0 +1,80 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "completion.h"
+
+namespace Maliit {
+namespace InputContext {
+
+struct Completion::State
+{
+    State()
+        : finished(false)
+        , succeeded(false)
+    {}
+
+    bool finished;
+    bool succeeded;
+    QList<Callback> callbacks;
+};
+
+Completion::Completion()
+    : d(new State)
+{
+}
+
+Completion Completion::finished(bool succeeded)
+{
+    Completion completion;
+    completion.finish(succeeded);
+    return completion;
+}
+
+bool Completion::isFinished() const
+{
+    return d->finished;
+}
+
+bool Completion::succeeded() const
+{
+    return d->succeeded;
+}
+
+void Completion::then(const Callback &callback) const
+{
+    if (d->finished) {
+        callback(d->succeeded);
+        return;
+    }
+    d->callbacks.append(callback);
+}
+
+void Completion::finish(bool succeeded) const
+{
+    if (d->finished)
+        return;
+
+    d->finished = true;
+    d->succeeded = succeeded;
+
+    // A callback may drop the last other reference to this state
+    const QSharedPointer<State> state(d);
+    const QList<Callback> callbacks(state->callbacks);
+    state->callbacks.clear();
+    Q_FOREACH (const Callback &callback, callbacks) {
+        callback(succeeded);
+    }
+}
+
+} // namespace InputContext
+} // namespace Maliit
@@ -0,0 +1,98 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_COMPLETION_H
+#define MALIIT_INPUTCONTEXT_COMPLETION_H
+
+#include <QList>
+#include <QSharedPointer>
+
+#include <functional>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define MALIIT_INPUTCONTEXT_COROUTINES
+#endif
+#endif
+
+namespace Maliit {
+namespace InputContext {
+
+/*! \brief Handle on a call the server has yet to acknowledge.
+ *
+ * Copies share the same state.  Callbacks registered with then() run once,
+ * on the connection's thread, when the server answered the call or it was
+ * given up on, e.g. because the connection was lost.  In C++20 builds the
+ * handle can also be awaited in a coroutine, which resumes with the outcome:
+ *
+ * \code
+ * if (co_await context->resetAsync())
+ *     ...
+ * \endcode
+ */
+class Completion
+{
+public:
+    typedef std::function<void(bool succeeded)> Callback;
+
+    //! \brief Creates a pending completion
+    Completion();
+
+    //! \brief Creates a completion that is already finished
+    static Completion finished(bool succeeded);
+
+    bool isFinished() const;
+    //! \brief Whether the server acknowledged the call, false while pending
+    bool succeeded() const;
+
+    //! \brief Calls \a callback once finished, right away if already finished
+    void then(const Callback &callback) const;
+
+    //! \brief Finishes the completion, later calls are ignored
+    void finish(bool succeeded) const;
+
+#ifdef MALIIT_INPUTCONTEXT_COROUTINES
+    struct Awaiter;
+    Awaiter operator co_await() const;
+#endif
+
+private:
+    struct State;
+    QSharedPointer<State> d;
+};
+
+#ifdef MALIIT_INPUTCONTEXT_COROUTINES
+struct Completion::Awaiter
+{
+    Completion completion;
+
+    bool await_ready() const { return completion.isFinished(); }
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        completion.then([handle](bool) { handle.resume(); });
+    }
+    bool await_resume() const { return completion.succeeded(); }
+};
+
+inline Completion::Awaiter Completion::operator co_await() const
+{
+    const Awaiter awaiter = { *this };
+    return awaiter;
+}
+#endif
+
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_COMPLETION_H
@@ -0,0 +1,139 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "connectionclock.h"
+
+#include <QMetaObject>
+#include <QTimer>
+
+namespace Maliit {
+namespace InputContext {
+
+namespace {
+    // Strips the SLOT() code and the signature, invokeMethod() wants the name
+    QByteArray methodName(const char *member)
+    {
+        QByteArray method(member + 1);
+        method.truncate(method.indexOf('('));
+        return method;
+    }
+}
+
+Clock::~Clock()
+{
+}
+
+SystemClock::SystemClock()
+    : mClock()
+{
+    mClock.start();
+}
+
+qint64 SystemClock::now() const
+{
+    return mClock.elapsed();
+}
+
+void SystemClock::schedule(int delay, QObject *receiver, const char *member)
+{
+    // Owned by the receiver and named after the member, so that cancel()
+    // can find it
+    QTimer *timer = new QTimer(receiver);
+    timer->setObjectName(QString::fromLatin1(member));
+    timer->setSingleShot(true);
+    QObject::connect(timer, SIGNAL(timeout()), receiver, member);
+    QObject::connect(timer, SIGNAL(timeout()), timer, SLOT(deleteLater()));
+    timer->start(qMax(delay, 0));
+}
+
+void SystemClock::cancel(QObject *receiver, const char *member)
+{
+    Q_FOREACH (QTimer *timer, receiver->findChildren<QTimer *>(QString::fromLatin1(member),
+                                                                Qt::FindDirectChildrenOnly)) {
+        timer->stop();
+        timer->deleteLater();
+    }
+}
+
+VirtualClock::VirtualClock()
+    : mNow(0)
+    , mEntries()
+{
+}
+
+qint64 VirtualClock::now() const
+{
+    return mNow;
+}
+
+void VirtualClock::schedule(int delay, QObject *receiver, const char *member)
+{
+    Entry entry;
+    entry.deadline = mNow + qMax(delay, 0);
+    entry.receiver = receiver;
+    entry.method = methodName(member);
+
+    QList<Entry>::iterator it = mEntries.begin();
+    while (it != mEntries.end() && it->deadline <= entry.deadline) {
+        ++it;
+    }
+    mEntries.insert(it, entry);
+}
+
+void VirtualClock::cancel(QObject *receiver, const char *member)
+{
+    const QByteArray method(methodName(member));
+    for (QList<Entry>::iterator it = mEntries.begin(); it != mEntries.end();) {
+        if (it->receiver == receiver && it->method == method) {
+            it = mEntries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void VirtualClock::advance(qint64 duration)
+{
+    const qint64 limit = mNow + qMax<qint64>(duration, 0);
+    while (runNext(limit)) {
+    }
+    mNow = limit;
+}
+
+bool VirtualClock::advanceToNext()
+{
+    return !mEntries.isEmpty() && runNext(mEntries.first().deadline);
+}
+
+int VirtualClock::pending() const
+{
+    return mEntries.size();
+}
+
+bool VirtualClock::runNext(qint64 limit)
+{
+    if (mEntries.isEmpty() || mEntries.first().deadline > limit) {
+        return false;
+    }
+
+    // Members may schedule more, so the entry is taken off first
+    const Entry entry(mEntries.takeFirst());
+    mNow = entry.deadline;
+    if (entry.receiver) {
+        QMetaObject::invokeMethod(entry.receiver.data(), entry.method.constData(), Qt::DirectConnection);
+    }
+    return true;
+}
+
+} // namespace InputContext
+} // namespace Maliit
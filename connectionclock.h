@@ -0,0 +1,103 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_CONNECTIONCLOCK_H
+#define MALIIT_INPUTCONTEXT_CONNECTIONCLOCK_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPointer>
+
+class QObject;
+
+namespace Maliit {
+namespace InputContext {
+
+/*! \brief Time source and one-shot timers of the connection lifecycle.
+ *
+ * Connecting, retrying and reconnecting, the protocol handshake timeout and
+ * the heartbeat are scheduled through this interface, so that they can run
+ * on a VirtualClock instead of wall time.
+ */
+class Clock
+{
+public:
+    virtual ~Clock();
+
+    //! \brief Monotonic time in ms
+    virtual qint64 now() const = 0;
+    //! \brief Invokes \a member, given as SLOT(name()), on \a receiver after \a delay ms
+    virtual void schedule(int delay, QObject *receiver, const char *member) = 0;
+    //! \brief Drops everything scheduled for \a member on \a receiver that did not run yet
+    virtual void cancel(QObject *receiver, const char *member) = 0;
+};
+
+//! \brief Wall time and QTimer, the default
+class SystemClock : public Clock
+{
+public:
+    SystemClock();
+
+    //! reimpl
+    virtual qint64 now() const;
+    virtual void schedule(int delay, QObject *receiver, const char *member);
+    virtual void cancel(QObject *receiver, const char *member);
+    //! reimpl end
+
+private:
+    QElapsedTimer mClock;
+};
+
+/*! \brief Time that only moves when told to.
+ *
+ * Scheduled members run from advance(), in the order they are due, with
+ * now() reporting their due time.  Receivers deleted in the meantime are
+ * skipped.
+ */
+class VirtualClock : public Clock
+{
+public:
+    VirtualClock();
+
+    //! reimpl
+    virtual qint64 now() const;
+    virtual void schedule(int delay, QObject *receiver, const char *member);
+    virtual void cancel(QObject *receiver, const char *member);
+    //! reimpl end
+
+    //! \brief Moves time forward by \a duration ms, running everything due until then
+    void advance(qint64 duration);
+    //! \brief Moves time to the next scheduled member and runs it, false if none
+    bool advanceToNext();
+    //! \brief Number of scheduled members that did not run yet
+    int pending() const;
+
+private:
+    struct Entry
+    {
+        qint64 deadline;
+        QPointer<QObject> receiver;
+        QByteArray method;
+    };
+
+    bool runNext(qint64 limit);
+
+    qint64 mNow;
+    QList<Entry> mEntries; //!< sorted by deadline, then by scheduling order
+};
+
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_CONNECTIONCLOCK_H
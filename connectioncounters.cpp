@@ -0,0 +1,174 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "connectioncounters.h"
+
+#include <QDBusVariant>
+#include <QMutex>
+
+#include <cstring>
+
+namespace
+{
+    const int MaxMethodNames(64);
+
+    const char * const CounterNames[] = {
+        "connects",
+        "disconnects",
+        "connect failures",
+        "pending resets",
+        "dropped commits",
+        "dropped preedits",
+        "queue overflows",
+        "lost calls"
+    };
+
+    // Registered names never change, readers only need the count
+    const char *methodNames[MaxMethodNames];
+    QAtomicInt methodCount;
+    QBasicMutex methodNamesMutex;
+}
+
+namespace Maliit {
+namespace InputContext {
+
+ConnectionCounters::ConnectionCounters()
+{
+    Q_STATIC_ASSERT(sizeof(CounterNames) / sizeof(CounterNames[0]) == CounterCount);
+    Q_STATIC_ASSERT(MaxMethodNames == MaxMethods);
+}
+
+int ConnectionCounters::method(const char *name)
+{
+    QMutexLocker locker(&methodNamesMutex);
+
+    const int count = methodCount.loadAcquire();
+    for (int i = 0; i < count; ++i) {
+        if (std::strcmp(methodNames[i], name) == 0) {
+            return i;
+        }
+    }
+
+    if (count == MaxMethodNames) {
+        return -1;
+    }
+
+    methodNames[count] = name;
+    methodCount.storeRelease(count + 1);
+    return count;
+}
+
+int ConnectionCounters::payloadSize(const QVariant &argument)
+{
+    switch (argument.userType()) {
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+        return 4;
+    case QMetaType::UChar:
+        return 1;
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Double:
+        return 8;
+    case QMetaType::QString:
+        return payloadSize(argument.toString());
+    case QMetaType::QByteArray:
+        return 4 + argument.toByteArray().size();
+    case QMetaType::QVariantList:
+        return 4 + payloadSize(argument.toList());
+    case QMetaType::QVariantMap: {
+        const QVariantMap map = argument.toMap();
+        int size = 4;
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            size += 5 + it.key().size() + 3 + payloadSize(it.value());
+        }
+        return size;
+    }
+    default:
+        break;
+    }
+
+    if (argument.userType() == qMetaTypeId<QDBusVariant>()) {
+        return 3 + payloadSize(argument.value<QDBusVariant>().variant());
+    }
+
+    // Already marshalled or custom types, their size is not known here
+    return 0;
+}
+
+int ConnectionCounters::payloadSize(const QList<QVariant> &arguments)
+{
+    int size = 0;
+    Q_FOREACH (const QVariant &argument, arguments) {
+        size += payloadSize(argument);
+    }
+    return size;
+}
+
+ConnectionCounters::Snapshot ConnectionCounters::snapshot() const
+{
+    Snapshot result;
+
+    for (int i = 0; i < CounterCount; ++i) {
+        result.counters[i] = mCounters[i].loadAcquire();
+    }
+
+    const int count = methodCount.loadAcquire();
+    for (int i = 0; i < count; ++i) {
+        const MethodSnapshot method = {
+            methodNames[i],
+            mMessages[i][Sent].loadAcquire(),
+            mBytes[i][Sent].loadAcquire(),
+            mMessages[i][Received].loadAcquire(),
+            mBytes[i][Received].loadAcquire()
+        };
+        if (method.sentMessages || method.receivedMessages) {
+            result.methods.append(method);
+        }
+    }
+
+    return result;
+}
+
+QString ConnectionCounters::report() const
+{
+    const Snapshot counters = snapshot();
+
+    QString result;
+    for (int i = 0; i < CounterCount; ++i) {
+        result += QString::fromLatin1("%1 %2\n")
+                .arg(QString::fromLatin1(CounterNames[i]), -32)
+                .arg(counters.counters[i], 10);
+    }
+
+    result += QString::fromLatin1("\n%1 %2 %3 %4 %5\n")
+            .arg(QString::fromLatin1("method"), -32)
+            .arg(QString::fromLatin1("sent"), 10)
+            .arg(QString::fromLatin1("sent bytes"), 12)
+            .arg(QString::fromLatin1("received"), 10)
+            .arg(QString::fromLatin1("recv bytes"), 12);
+
+    Q_FOREACH (const MethodSnapshot &method, counters.methods) {
+        result += QString::fromLatin1("%1 %2 %3 %4 %5\n")
+                .arg(QString::fromLatin1(method.method), -32)
+                .arg(method.sentMessages, 10)
+                .arg(method.sentBytes, 12)
+                .arg(method.receivedMessages, 10)
+                .arg(method.receivedBytes, 12);
+    }
+    return result;
+}
+
+} // namespace InputContext
+} // namespace Maliit
@@ -0,0 +1,116 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_CONNECTIONCOUNTERS_H
+#define MALIIT_INPUTCONTEXT_CONNECTIONCOUNTERS_H
+
+#include <QAtomicInteger>
+#include <QList>
+#include <QString>
+#include <QVariant>
+
+namespace Maliit {
+namespace InputContext {
+
+/*! \brief Traffic and health counters of a server connection.
+ *
+ * Every update is a single relaxed atomic add, so counting is cheap enough
+ * for the hot paths and the counters can be read from any thread.  A
+ * snapshot reads each counter once; counters updated meanwhile may be a
+ * message apart from each other.
+ */
+class ConnectionCounters
+{
+public:
+    enum Counter {
+        Connects,           //!< connections established, including reconnects
+        Disconnects,
+        ConnectFailures,    //!< attempts that failed and were retried
+        PendingResets,      //!< synchronized resets queued or awaiting an answer, a gauge
+        DroppedCommits,     //!< commits discarded while resets were pending
+        DroppedPreedits,    //!< preedits discarded while resets were pending
+        QueueOverflows,     //!< calls failed because the critical lane was full
+        LostCalls,          //!< one-way calls a failed acknowledgement covered, not sent again
+        CounterCount
+    };
+
+    enum Direction {
+        Sent,
+        Received
+    };
+
+    struct MethodSnapshot
+    {
+        const char *method;
+        qint64 sentMessages;
+        qint64 sentBytes;
+        qint64 receivedMessages;
+        qint64 receivedBytes;
+    };
+
+    struct Snapshot
+    {
+        qint64 counters[CounterCount];
+        QList<MethodSnapshot> methods; //!< methods with traffic, in registration order
+    };
+
+    ConnectionCounters();
+
+    /*! \brief Index of the counters for D-Bus method \a name.
+     *
+     * Indexes are shared by all connections.  Meant to be looked up once and
+     * kept, e.g. in a function local static; \a name must outlive the process.
+     * Returns -1 once the table is full, which countMessage() ignores.
+     */
+    static int method(const char *name);
+
+    //! \brief Estimated marshalled size of D-Bus arguments in bytes
+    static int payloadSize(const QVariant &argument);
+    static int payloadSize(const QList<QVariant> &arguments);
+    static int payloadSize(const QString &argument)
+    {
+        // length, characters and terminator; exact for ASCII
+        return 5 + argument.size();
+    }
+
+    void add(Counter counter, qint64 delta = 1)
+    {
+        mCounters[counter].fetchAndAddRelaxed(delta);
+    }
+
+    void countMessage(int method, Direction direction, int bytes)
+    {
+        if (method < 0)
+            return;
+        mMessages[method][direction].fetchAndAddRelaxed(1);
+        mBytes[method][direction].fetchAndAddRelaxed(bytes);
+    }
+
+    Snapshot snapshot() const;
+    //! \brief Text table of the counters and of the traffic per method
+    QString report() const;
+
+private:
+    Q_DISABLE_COPY(ConnectionCounters)
+
+    enum { MaxMethods = 64 };
+
+    QAtomicInteger<qint64> mCounters[CounterCount];
+    QAtomicInteger<qint64> mMessages[MaxMethods][2];
+    QAtomicInteger<qint64> mBytes[MaxMethods][2];
+};
+
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_CONNECTIONCOUNTERS_H
@@ -53,7 +53,96 @@
 #include <QtCore/QVariant>
 
 #include "namespace.h"
+#include "allocationstats.h"
 #include "dbusserverconnection.h"
+#include "tracepoints.h"
+#include "tracing.h"
+
+namespace
+{
+    using Maliit::InputContext::ConnectionCounters;
+
+    enum IncomingMethod {
+        ActivationLostEventMethod,
+        CommitStringMethod,
+        UpdatePreeditMethod,
+        CopyMethod,
+        EventStampMethod,
+        ExtendedAttributeChangedMethod,
+        ImInitiatedHideMethod,
+        KeyEventMethod,
+        PasteMethod,
+        PluginSettingsLoadedMethod,
+        PreeditRectangleMethod,
+        RequestSurroundingTextMethod,
+        SelectionMethod,
+        SetDetectableAutoRepeatMethod,
+        SetGlobalCorrectionEnabledMethod,
+        SetLanguageMethod,
+        SetRedirectKeysMethod,
+        SetRedirectKeyFilterMethod,
+        SetSelectionMethod,
+        UpdateInputMethodAreaMethod,
+        IncomingMethodCount
+    };
+
+    // Indexed by IncomingMethod
+    const char * const IncomingMethodNames[] = {
+        "activationLostEvent",
+        "commitString",
+        "updatePreedit",
+        "copy",
+        "eventStamp",
+        "extendedAttributeChanged",
+        "imInitiatedHide",
+        "keyEvent",
+        "paste",
+        "pluginSettingsLoaded",
+        "preeditRectangle",
+        "requestSurroundingText",
+        "selection",
+        "setDetectableAutoRepeat",
+        "setGlobalCorrectionEnabled",
+        "setLanguage",
+        "setRedirectKeys",
+        "setRedirectKeyFilter",
+        "setSelection",
+        "updateInputMethodArea"
+    };
+
+    struct CountedMethods
+    {
+        CountedMethods()
+        {
+            for (int i = 0; i < IncomingMethodCount; ++i) {
+                index[i] = ConnectionCounters::method(IncomingMethodNames[i]);
+            }
+        }
+
+        int index[IncomingMethodCount];
+    };
+
+    //! Bookkeeping done for every method call received from the server
+    class IncomingCall
+    {
+    public:
+        IncomingCall(DBusServerConnection *connection, IncomingMethod method, int payloadSize)
+            : span(IncomingMethodNames[method], "dispatch")
+            , allocations(IncomingMethodNames[method])
+        {
+            static const CountedMethods methods;
+            connection->counters().countMessage(methods.index[method],
+                                                ConnectionCounters::Received,
+                                                payloadSize);
+            MALIIT_TRACEPOINT3(incoming_dispatch, IncomingMethodNames[method], payloadSize,
+                               MALIIT_TRACEPOINT_NOW());
+        }
+
+    private:
+        Maliit::InputContext::TraceSpan span;
+        Maliit::InputContext::AllocationScope allocations;
+    };
+}
 
 /*
  * Implementation of adaptor class Inputcontext1Adaptor
@@ -71,102 +160,179 @@ Inputcontext1Adaptor::~Inputcontext1Adaptor()
     // destructor
 }
 
+DBusServerConnection *Inputcontext1Adaptor::connection() const
+{
+    // Calls are forwarded directly rather than through
+    // QMetaObject::invokeMethod(), which builds and looks up the method
+    // signature on every call.
+    return static_cast<DBusServerConnection *>(parent());
+}
+
 void Inputcontext1Adaptor::activationLostEvent()
 {
     // handle method call com.meego.inputmethod.inputcontext1.activationLostEvent
-    QMetaObject::invokeMethod(parent(), "activationLostEvent");
+    IncomingCall call(connection(), ActivationLostEventMethod, 0);
+    Q_EMIT connection()->activationLostEvent();
 }
 
 void Inputcontext1Adaptor::commitString(const QString &in0, int in1, int in2, int in3)
 {
     // handle method call com.meego.inputmethod.inputcontext1.commitString
-    QMetaObject::invokeMethod(parent(), "commitString", Q_ARG(QString, in0), Q_ARG(int, in1), Q_ARG(int, in2), Q_ARG(int, in3));
+    IncomingCall call(connection(), CommitStringMethod, ConnectionCounters::payloadSize(in0) + 12);
+    Q_EMIT connection()->commitString(in0, in1, in2, in3);
 }
 
 void Inputcontext1Adaptor::updatePreedit(const QDBusMessage &message)
 {
     // handle method call com.meego.inputmethod.inputcontext1.updatePreedit
-    QList<QVariant> args = message.arguments();
+    const QList<QVariant> args = message.arguments();
+    IncomingCall call(connection(), UpdatePreeditMethod, ConnectionCounters::payloadSize(args));
     if (args.length() != 5)
     {
         return;
     }
 
-    QMetaObject::invokeMethod(parent(), "updatePreedit", Q_ARG(QString, args[0].toString()),
-            Q_ARG(QList<Maliit::PreeditTextFormat>, args[1].value<QList<Maliit::PreeditTextFormat> >()),
-            Q_ARG(int, args[2].toInt()), Q_ARG(int, args[3].toInt()), Q_ARG(int, args[4].toInt()));
+    Q_EMIT connection()->updatePreedit(args[0].toString(),
+            args[1].value<QList<Maliit::PreeditTextFormat> >(),
+            args[2].toInt(), args[3].toInt(), args[4].toInt());
 }
 
 void Inputcontext1Adaptor::copy()
 {
     // handle method call com.meego.inputmethod.inputcontext1.copy
+    IncomingCall call(connection(), CopyMethod, 0);
     QMetaObject::invokeMethod(parent(), "copy");
 }
 
+void Inputcontext1Adaptor::eventStamp(uint in0)
+{
+    // handle method call com.meego.inputmethod.inputcontext1.eventStamp
+    IncomingCall call(connection(), EventStampMethod, 4);
+    Q_EMIT connection()->eventStamp(in0);
+}
+
+void Inputcontext1Adaptor::extendedAttributeChanged(int in0, const QString &in1, const QString &in2, const QString &in3, const QDBusVariant &in4)
+{
+    // handle method call com.meego.inputmethod.inputcontext1.extendedAttributeChanged
+    IncomingCall call(connection(), ExtendedAttributeChangedMethod,
+                      ConnectionCounters::payloadSize(in1) + ConnectionCounters::payloadSize(in2)
+                      + ConnectionCounters::payloadSize(in3) + 4);
+    Q_EMIT connection()->extendedAttributeChanged(in0, in1, in2, in3, in4.variant());
+}
+
 void Inputcontext1Adaptor::imInitiatedHide()
 {
     // handle method call com.meego.inputmethod.inputcontext1.imInitiatedHide
-    QMetaObject::invokeMethod(parent(), "imInitiatedHide");
+    IncomingCall call(connection(), ImInitiatedHideMethod, 0);
+    Q_EMIT connection()->imInitiatedHide();
 }
 
 void Inputcontext1Adaptor::keyEvent(int in0, int in1, int in2, const QString &in3, bool in4, int in5, uchar in6)
 {
     // handle method call com.meego.inputmethod.inputcontext1.keyEvent
-    QMetaObject::invokeMethod(parent(), "keyEvent", Q_ARG(int, in0), Q_ARG(int, in1), Q_ARG(int, in2), Q_ARG(QString, in3), Q_ARG(bool, in4), Q_ARG(int, in5), Q_ARG(Maliit::EventRequestType, (Maliit::EventRequestType)in6));
+    IncomingCall call(connection(), KeyEventMethod, ConnectionCounters::payloadSize(in3) + 21);
+    connection()->keyEvent(in0, in1, in2, in3, in4, in5, in6);
 }
 
 void Inputcontext1Adaptor::paste()
 {
     // handle method call com.meego.inputmethod.inputcontext1.paste
+    IncomingCall call(connection(), PasteMethod, 0);
     QMetaObject::invokeMethod(parent(), "paste");
 }
 
+void Inputcontext1Adaptor::pluginSettingsLoaded(const QList<MImPluginSettingsInfo> &in0)
+{
+    // handle method call com.meego.inputmethod.inputcontext1.pluginSettingsLoaded
+    IncomingCall call(connection(), PluginSettingsLoadedMethod, 0);
+    connection()->pluginSettingsLoaded(in0);
+}
+
 bool Inputcontext1Adaptor::preeditRectangle(int &out1, int &out2, int &out3, int &out4)
 {
     // handle method call com.meego.inputmethod.inputcontext1.preeditRectangle
-    return static_cast<DBusServerConnection *>(parent())->preeditRectangle(out1, out2, out3, out4);
+    IncomingCall call(connection(), PreeditRectangleMethod, 0);
+    return connection()->preeditRectangle(out1, out2, out3, out4);
+}
+
+void Inputcontext1Adaptor::requestSurroundingText()
+{
+    // handle method call com.meego.inputmethod.inputcontext1.requestSurroundingText
+    IncomingCall call(connection(), RequestSurroundingTextMethod, 0);
+    connection()->resendSurroundingText();
 }
 
 bool Inputcontext1Adaptor::selection(QString &out1)
 {
     // handle method call com.meego.inputmethod.inputcontext1.selection
-    return static_cast<DBusServerConnection *>(parent())->selection(out1);
+    IncomingCall call(connection(), SelectionMethod, 0);
+    return connection()->selection(out1);
 }
 
 void Inputcontext1Adaptor::setDetectableAutoRepeat(bool in0)
 {
     // handle method call com.meego.inputmethod.inputcontext1.setDetectableAutoRepeat
-    QMetaObject::invokeMethod(parent(), "setDetectableAutoRepeat", Q_ARG(bool, in0));
+    IncomingCall call(connection(), SetDetectableAutoRepeatMethod, 4);
+    Q_EMIT connection()->setDetectableAutoRepeat(in0);
 }
 
 void Inputcontext1Adaptor::setGlobalCorrectionEnabled(bool in0)
 {
     // handle method call com.meego.inputmethod.inputcontext1.setGlobalCorrectionEnabled
-    QMetaObject::invokeMethod(parent(), "setGlobalCorrectionEnabled", Q_ARG(bool, in0));
+    IncomingCall call(connection(), SetGlobalCorrectionEnabledMethod, 4);
+    Q_EMIT connection()->setGlobalCorrectionEnabled(in0);
 }
 
 void Inputcontext1Adaptor::setLanguage(const QString &in0)
 {
     // handle method call com.meego.inputmethod.inputcontext1.setLanguage
-    QMetaObject::invokeMethod(parent(), "setLanguage", Q_ARG(QString, in0));
+    IncomingCall call(connection(), SetLanguageMethod, ConnectionCounters::payloadSize(in0));
+    Q_EMIT connection()->setLanguage(in0);
 }
 
 void Inputcontext1Adaptor::setRedirectKeys(bool in0)
 {
     // handle method call com.meego.inputmethod.inputcontext1.setRedirectKeys
-    QMetaObject::invokeMethod(parent(), "setRedirectKeys", Q_ARG(bool, in0));
+    IncomingCall call(connection(), SetRedirectKeysMethod, 4);
+    Q_EMIT connection()->setRedirectKeys(in0);
+}
+
+void Inputcontext1Adaptor::setRedirectKeyFilter(const QDBusMessage &message)
+{
+    // handle method call com.meego.inputmethod.inputcontext1.setRedirectKeyFilter
+    const QList<QVariant> args = message.arguments();
+    IncomingCall call(connection(), SetRedirectKeyFilterMethod, ConnectionCounters::payloadSize(args));
+    if (args.length() != 1)
+    {
+        return;
+    }
+
+    QList<Maliit::KeyRedirectRule> rules;
+    const QDBusArgument argument = args[0].value<QDBusArgument>();
+    argument.beginArray();
+    while (!argument.atEnd()) {
+        Maliit::KeyRedirectRule rule;
+        argument.beginStructure();
+        argument >> rule.key >> rule.modifiers >> rule.modifierMask >> rule.contentTypes;
+        argument.endStructure();
+        rules.append(rule);
+    }
+    argument.endArray();
+
+    Q_EMIT connection()->setRedirectKeyFilter(rules);
 }
 
 void Inputcontext1Adaptor::setSelection(int in0, int in1)
 {
     // handle method call com.meego.inputmethod.inputcontext1.setSelection
-    QMetaObject::invokeMethod(parent(), "setSelection", Q_ARG(int, in0), Q_ARG(int, in1));
+    IncomingCall call(connection(), SetSelectionMethod, 8);
+    Q_EMIT connection()->setSelection(in0, in1);
 }
 
 void Inputcontext1Adaptor::updateInputMethodArea(int in0, int in1, int in2, int in3)
 {
     // handle method call com.meego.inputmethod.inputcontext1.updateInputMethodArea
-    QRect rect(in0, in1, in2, in3);
-    QMetaObject::invokeMethod(parent(), "updateInputMethodArea", Q_ARG(QRect, rect));
+    IncomingCall call(connection(), UpdateInputMethodAreaMethod, 16);
+    connection()->updateInputMethodArea(in0, in1, in2, in3);
 }
 
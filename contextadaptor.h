@@ -51,6 +51,10 @@
 #include <QtCore/QVariant>
 #include <QtDBus/QtDBus>
 
+#include "settingdata.h"
+
+class DBusServerConnection;
+
 /*
  * Adaptor class for interface com.meego.inputmethod.inputcontext1
  */
@@ -105,6 +109,9 @@ class Inputcontext1Adaptor: public QDBusAbstractAdaptor
 "    <method name=\"setRedirectKeys\">\n"
 "      <arg type=\"b\"/>\n"
 "    </method>\n"
+"    <method name=\"setRedirectKeyFilter\">\n"
+"      <arg type=\"a(iiii)\"/>\n"
+"    </method>\n"
 "    <method name=\"setDetectableAutoRepeat\">\n"
 "      <arg type=\"b\"/>\n"
 "    </method>\n"
@@ -119,6 +126,20 @@ class Inputcontext1Adaptor: public QDBusAbstractAdaptor
 "    <method name=\"setLanguage\">\n"
 "      <arg type=\"s\"/>\n"
 "    </method>\n"
+"    <method name=\"extendedAttributeChanged\">\n"
+"      <arg type=\"i\"/>\n"
+"      <arg type=\"s\"/>\n"
+"      <arg type=\"s\"/>\n"
+"      <arg type=\"s\"/>\n"
+"      <arg type=\"v\"/>\n"
+"    </method>\n"
+"    <method name=\"eventStamp\">\n"
+"      <arg type=\"u\"/>\n"
+"    </method>\n"
+"    <method name=\"requestSurroundingText\"/>\n"
+"    <method name=\"pluginSettingsLoaded\">\n"
+"      <arg type=\"a(sssia(ssibva{sv}))\"/>\n"
+"    </method>\n"
 "  </interface>\n"
         "")
 public:
@@ -131,18 +152,26 @@ public Q_SLOTS: // METHODS
     void commitString(const QString &in0, int in1, int in2, int in3);
     void updatePreedit(const QDBusMessage &message);
     void copy();
+    void eventStamp(uint in0);
+    void extendedAttributeChanged(int in0, const QString &in1, const QString &in2, const QString &in3, const QDBusVariant &in4);
     void imInitiatedHide();
     void keyEvent(int in0, int in1, int in2, const QString &in3, bool in4, int in5, uchar in6);
     void paste();
+    void pluginSettingsLoaded(const QList<MImPluginSettingsInfo> &in0);
     bool preeditRectangle(int &out1, int &out2, int &out3, int &out4);
+    void requestSurroundingText();
     bool selection(QString &out1);
     void setDetectableAutoRepeat(bool in0);
     void setGlobalCorrectionEnabled(bool in0);
     void setLanguage(const QString &in0);
     void setRedirectKeys(bool in0);
+    void setRedirectKeyFilter(const QDBusMessage &message);
     void setSelection(int in0, int in1);
     void updateInputMethodArea(int in0, int in1, int in2, int in3);
 Q_SIGNALS: // SIGNALS
+
+private:
+    DBusServerConnection *connection() const;
 };
 
 #endif
@@ -17,193 +17,1726 @@
  */
 
 #include "dbusserverconnection.h"
+#include "allocationstats.h"
 #include "contextadaptor.h"
+#include "pluginsettingscache.h"
 #include "serverproxy.h"
+#include "tracepoints.h"
+#include "tracing.h"
 
-#include <QDBusConnection>
+#include <QCryptographicHash>
+#include <QDBusMessage>
+#include <QDBusMetaType>
 #include <QDebug>
+#include <QMutex>
+#include <QPointer>
 
 namespace
 {
     const char * const IMServerPath("/com/meego/inputmethod/uiserver1");
     const char * const IMServerConnection("Maliit::IMServerConnection");
     const char * const InputContextAdaptorPath("/com/meego/inputmethod/inputcontext");
-    const char * const DBusLocalPath("/org/freedesktop/DBus/Local");
-    const char * const DBusLocalInterface("org.freedesktop.DBus.Local");
-    const char * const DisconnectedSignal("Disconnected");
-    const int ConnectionRetryInterval(6*1000); // in ms
+    const char * const NegotiateProtocolMethod("negotiateProtocol");
+    const char * const DBusPropertiesInterface("org.freedesktop.DBus.Properties");
+    const char * const DBusPropertiesGetAllMethod("GetAll");
+    const char * const DBusIntrospectableInterface("org.freedesktop.DBus.Introspectable");
+    const char * const DBusIntrospectMethod("Introspect");
+    const char * const CompoundCallIntrospection("<method name=\"compoundCall\"");
+    const char * const DBusUnknownMethodError("org.freedesktop.DBus.Error.UnknownMethod");
+    const char * const InputStampIntrospection("<method name=\"inputStamp\"");
+    const char * const SurroundingTextIntrospection("<method name=\"updateSurroundingText\"");
+    const char * const SurroundingTextKey("surroundingText");
+    const char * const CursorPositionKey("cursorPosition");
+    const char * const AnchorPositionKey("anchorPosition");
+    const int DefaultConnectionRetryInterval(6*1000); // in ms
+    const int DefaultMaxInFlightCalls(64);
+    const int AcknowledgementInterval(8); // one-way calls per acknowledged one
+    const int MaxQueuedCriticalCalls(512);
+    const quint32 MaxTrackedInputStamps(64);
+    const uint ProtocolVersion(1);
+    const int ProtocolNegotiationTimeout(1000); // in ms
+
+    // Indexed by DBusServerConnection::Call
+    const char * const CallNames[] = {
+        "activateContext",
+        "showInputMethod",
+        "hideInputMethod",
+        "mouseClickedOnPreedit",
+        "setPreedit",
+        "updateWidgetInformation",
+        "reset",
+        "appOrientationAboutToChange",
+        "appOrientationChanged",
+        "setCopyPasteState",
+        "processKeyEvent",
+        "registerAttributeExtension",
+        "unregisterAttributeExtension",
+        "setExtendedAttribute",
+        "loadPluginSettings",
+        "inputStamp",
+        "updateSurroundingText",
+        "compoundCall"
+    };
+
+    /* Strings and indices every connection needs, built once per process
+     * rather than on every connect and every call.  QString copies share
+     * their data, so handing them to QtDBus does not allocate.
+     */
+    struct ConnectionMetadata
+    {
+        ConnectionMetadata()
+            : serverPath(QString::fromLatin1(IMServerPath))
+            , serverInterface(QString::fromLatin1(ComMeegoInputmethodUiserver1Interface::staticInterfaceName()))
+            , adaptorPath(QString::fromLatin1(InputContextAdaptorPath))
+        {
+            for (size_t i = 0; i < sizeof(CallNames) / sizeof(CallNames[0]); ++i) {
+                methodNames[i] = QString::fromLatin1(CallNames[i]);
+                countedMethods[i] = Maliit::InputContext::ConnectionCounters::method(CallNames[i]);
+            }
+        }
+
+        QString serverPath;
+        QString serverInterface;
+        QString adaptorPath;
+        QString methodNames[sizeof(CallNames) / sizeof(CallNames[0])];
+        int countedMethods[sizeof(CallNames) / sizeof(CallNames[0])];
+    };
+
+    const ConnectionMetadata &metadata()
+    {
+        static const ConnectionMetadata connectionMetadata;
+        return connectionMetadata;
+    }
+
+    int countedMethod(int call)
+    {
+        return metadata().countedMethods[call];
+    }
+
+    QDBusMessage serverCall(const QString &method)
+    {
+        const ConnectionMetadata &strings = metadata();
+        return QDBusMessage::createMethodCall(QString(), strings.serverPath, strings.serverInterface, method);
+    }
+
+    /* Every connection has a peer connection of its own: the adaptor can be
+     * registered only once per peer connection, and each input context
+     * connects and disconnects on its own.
+     */
+    QString connectionName(const QString &seat)
+    {
+        static QAtomicInt serial;
+        QString name(QString::fromLatin1(IMServerConnection));
+        if (!seat.isEmpty()) {
+            name += QLatin1Char('/') + seat;
+        }
+        return name + QLatin1Char('/') + QString::number(serial.fetchAndAddRelaxed(1));
+    }
+
+    //! Addresses of servers that answered the handshake, shared by all threads
+    typedef QSet<QString> NegotiatedServers;
+    Q_GLOBAL_STATIC(NegotiatedServers, negotiatedServers)
+    Q_GLOBAL_STATIC(QMutex, negotiatedServersMutex)
+
+    void finishCompletions(const QList<Maliit::InputContext::Completion> &completions, bool succeeded)
+    {
+        Q_FOREACH (const Maliit::InputContext::Completion &completion, completions) {
+            completion.finish(succeeded);
+        }
+    }
+
+    QString attributeKey(int id, const QString &target, const QString &targetItem,
+                         const QString &attribute)
+    {
+        const QChar separator(0x1f);
+        return QString::number(id) + separator + target + separator + targetItem + separator + attribute;
+    }
+
+    //! One call of a compoundCall, marshalled as (sav)
+    struct CompoundCallEntry
+    {
+        QString method;
+        QVariantList arguments;
+    };
+
+    QDBusArgument &operator<<(QDBusArgument &argument, const CompoundCallEntry &entry)
+    {
+        argument.beginStructure();
+        argument << entry.method << entry.arguments;
+        argument.endStructure();
+        return argument;
+    }
+
+    const QDBusArgument &operator>>(const QDBusArgument &argument, CompoundCallEntry &entry)
+    {
+        argument.beginStructure();
+        argument >> entry.method >> entry.arguments;
+        argument.endStructure();
+        return argument;
+    }
 }
 
-DBusServerConnection::DBusServerConnection(const QSharedPointer<Maliit::InputContext::DBus::Address> &address) :
+Q_DECLARE_METATYPE(CompoundCallEntry)
+Q_DECLARE_METATYPE(QList<CompoundCallEntry>)
+
+DBusServerConnection::DBusServerConnection(const QSharedPointer<Maliit::InputContext::DBus::Address> &address,
+                                           const QSharedPointer<Maliit::InputContext::Clock> &clock,
+                                           const QString &seat,
+                                           const QSharedPointer<Maliit::InputContext::DBus::Transport> &transport) :
     MImServerConnection(0)
   , mAddress(address)
-  , mProxy(0)
+  , mClock(clock ? clock : QSharedPointer<Maliit::InputContext::Clock>(new Maliit::InputContext::SystemClock))
+  , mTransport(transport ? transport
+                         : QSharedPointer<Maliit::InputContext::DBus::Transport>(new Maliit::InputContext::DBus::PeerTransport))
+  , mSeat(seat)
+  , mConnectionName(connectionName(seat))
+  , mRetryInterval(DefaultConnectionRetryInterval)
+  , mDisconnectedAt(-1)
+  , mRecoveryTime(-1)
+  , mSurroundingText()
+  , mSurroundingCursor(-1)
+  , mSurroundingAnchor(-1)
+  , mSurroundingRevision(0)
+  , mSurroundingAcknowledged(0)
+  , mSurroundingSynced(false)
+  , mSurroundingPending(false)
+  , mSurroundingWhole(false)
+  , mSurroundingDirty(false)
+  , mSurroundingPrefix(0)
+  , mSurroundingSuffix(0)
+  , mSurroundingSentSize(0)
+  , mConnectClock()
+  , mPhaseStart(0)
+  , mConnectTimings()
+  , mLastConnectTimings()
+  , mAddressRequested(-1)
+  , mPeer(0)
   , mActive(true)
   , pendingResetCalls()
+  , mPriorityLanes(true)
+  , mCriticalLane()
+  , mBulkLane()
+  , mBulkFlushTimer()
+  , mInFlightCalls()
+  , mInFlightCount(0)
+  , mOneWayCalls(true)
+  , mUnacknowledgedCalls()
+  , mAcknowledgedCalls()
+  , mMadeCalls(CallCount, 0)
+  , mCompletions()
+  , mMaxInFlightCalls(DefaultMaxInFlightCalls)
+  , mQueuedSynchronizedCalls(0)
+  , mStatistics()
+  , mHeartbeatInterval(0)
+  , mHeartbeatBudget(0)
+  , mHeartbeatSentAt(-1)
+  , mHeartbeat(0)
+  , mServerResponseTime(-1)
+  , mServerResponsive(true)
+  , mServerAddress()
+  , mHandshake(0)
+  , mConnecting(false)
+  , mProtocolVersion(0)
+  , mFeatures()
+  , mIntrospection(0)
+  , mCompoundDepth(0)
+  , mCompound()
+  , mAttributeExtensions()
+  , mRegisteredExtensions()
+  , mExtendedAttributes()
+  , mPendingAttributes()
+  , mAttributeFlushTimer()
+  , mServerVersion()
+  , mPluginSettingsLanguage()
+  , mPluginSettings()
+  , mPluginSettingsRequested(false)
+  , mPluginSettingsDelivered(false)
+  , mInputStampsEnabled(false)
+  , mLastInputStamp(0)
+  , mNextInputStamp(0)
+  , mInputStampClock()
+  , mInputStampTimes()
 {
     new Inputcontext1Adaptor(this);
 
+    qDBusRegisterMetaType<CompoundCallEntry>();
+    qDBusRegisterMetaType<QList<CompoundCallEntry> >();
+    qDBusRegisterMetaType<MImPluginSettingsEntry>();
+    qDBusRegisterMetaType<MImPluginSettingsInfo>();
+    qDBusRegisterMetaType<QList<MImPluginSettingsInfo> >();
+
+    // Labels are often updated on every keystroke, send them once per tick
+    mAttributeFlushTimer.setSingleShot(true);
+    mAttributeFlushTimer.setInterval(0);
+    connect(&mAttributeFlushTimer, SIGNAL(timeout()), this, SLOT(flushExtendedAttributes()));
+
+    mBulkFlushTimer.setSingleShot(true);
+    mBulkFlushTimer.setInterval(0);
+    connect(&mBulkFlushTimer, SIGNAL(timeout()), this, SLOT(flushBulkLane()));
+
+    mInputStampClock.start();
+
     connect(mAddress.data(), SIGNAL(addressReceived(QString)),
             this, SLOT(openDBusConnection(QString)));
     connect(mAddress.data(), SIGNAL(addressFetchError(QString)),
             this, SLOT(connectToDBusFailed(QString)));
 
-    QTimer::singleShot(0, this, SLOT(connectToDBus()));
+    mDisconnectedAt = mClock->now();
+    mConnectClock.start();
+    mClock->schedule(0, this, SLOT(connectToDBus()));
 }
 
 DBusServerConnection::~DBusServerConnection()
 {
+    Q_FOREACH (int id, mAttributeExtensions.keys()) {
+        unregisterAttributeExtension(id);
+    }
+
     mActive = false;
-    Q_FOREACH (QDBusPendingCallWatcher *watcher, pendingResetCalls) {
+    QSet<QDBusPendingCallWatcher*> watchers(pendingResetCalls);
+    for (QHash<QDBusPendingCallWatcher*, int>::const_iterator it = mInFlightCalls.constBegin();
+         it != mInFlightCalls.constEnd(); ++it) {
+        watchers.insert(it.key());
+    }
+    for (QHash<QDBusPendingCallWatcher*, Completions>::const_iterator it = mCompletions.constBegin();
+         it != mCompletions.constEnd(); ++it) {
+        watchers.insert(it.key());
+    }
+    Q_FOREACH (QDBusPendingCallWatcher *watcher, watchers) {
         disconnect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
-                   this, SLOT(resetCallFinished(QDBusPendingCallWatcher*)));
+                   this, SLOT(callFinished(QDBusPendingCallWatcher*)));
+    }
+    // Calls made by the callbacks below fail right away
+    delete mPeer;
+    mPeer = 0;
+    abandonCalls();
+    stopHeartbeat();
+    if (mHandshake) {
+        disconnect(mHandshake, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                   this, SLOT(protocolNegotiated(QDBusPendingCallWatcher*)));
+    }
+    if (mIntrospection) {
+        disconnect(mIntrospection, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                   this, SLOT(serverIntrospected(QDBusPendingCallWatcher*)));
     }
 }
 
 void DBusServerConnection::connectToDBus()
 {
+    mAddressRequested = Maliit::InputContext::Tracing::enabled() ? Maliit::InputContext::Tracing::now() : -1;
+    mPhaseStart = mConnectClock.nsecsElapsed();
     mAddress->get();
 }
 
+void DBusServerConnection::traceAddressResolution()
+{
+    if (mAddressRequested < 0)
+        return;
+
+    Maliit::InputContext::Tracing::record("resolveAddress", "connection",
+                                          mAddressRequested, Maliit::InputContext::Tracing::now());
+    mAddressRequested = -1;
+}
+
 void DBusServerConnection::openDBusConnection(const QString &addressString)
 {
+    traceAddressResolution();
+    mConnectTimings.addressResolution = phaseTime();
+    Maliit::InputContext::TraceSpan span("connectToPeer", "connection");
+
     if (addressString.isEmpty()) {
-        QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToDBus()));
+        counters().add(Maliit::InputContext::ConnectionCounters::ConnectFailures);
+        mClock->schedule(mRetryInterval, this, SLOT(connectToDBus()));
         return;
     }
 
-    QDBusConnection connection = QDBusConnection::connectToPeer(addressString, QString::fromLatin1(IMServerConnection));
-    if (!connection.isConnected()) {
-        QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToDBus()));
+    mPeer = mTransport->connectToPeer(addressString, mConnectionName);
+    if (!mPeer) {
+        counters().add(Maliit::InputContext::ConnectionCounters::ConnectFailures);
+        mClock->schedule(mRetryInterval, this, SLOT(connectToDBus()));
         return;
     }
 
-    mProxy = new ComMeegoInputmethodUiserver1Interface(QString(), QString::fromLatin1(IMServerPath), connection, this);
+    mConnectTimings.peerConnection = phaseTime();
 
-    connection.connect(QString(), QString::fromLatin1(DBusLocalPath), QString::fromLatin1(DBusLocalInterface),
-                       QString::fromLatin1(DisconnectedSignal),
-                       this, SLOT(onDisconnection()));
-
-    connection.registerObject(QString::fromLatin1(InputContextAdaptorPath), this);
+    connect(mPeer, SIGNAL(disconnected()), this, SLOT(onDisconnection()));
+    mPeer->registerObject(metadata().adaptorPath, this);
+    mConnectTimings.objectSetup = phaseTime();
 
 #if 0
     connect(mProxy, SIGNAL(invokeAction(QString,QKeySequence)), this, SIGNAL(invokeAction(QString,QKeySequence)));
 #endif
+    mServerAddress = addressString;
+    startHeartbeat();
+    const bool negotiated = negotiateProtocol();
+    registerAttributeExtensions();
+    requestPluginSettings();
+
+    mConnecting = !negotiated;
+    if (negotiated) {
+        finishConnecting();
+    }
+}
+
+void DBusServerConnection::finishConnecting()
+{
+    mConnecting = false;
+    mConnectTimings.negotiation = phaseTime();
+    mConnectTimings.total = mConnectClock.nsecsElapsed() / 1000;
+    mLastConnectTimings = mConnectTimings;
+    mRecoveryTime = mClock->now() - mDisconnectedAt;
+    mDisconnectedAt = -1;
+    counters().add(Maliit::InputContext::ConnectionCounters::Connects);
+    MALIIT_TRACEPOINT2(connect, mServerAddress.toUtf8().constData(), MALIIT_TRACEPOINT_NOW());
     Q_EMIT connected();
 }
 
 void DBusServerConnection::connectToDBusFailed(const QString &)
 {
-    QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToDBus()));
+    traceAddressResolution();
+    counters().add(Maliit::InputContext::ConnectionCounters::ConnectFailures);
+    mClock->schedule(mRetryInterval, this, SLOT(connectToDBus()));
 }
 
 void DBusServerConnection::onDisconnection()
 {
-    delete mProxy;
-    mProxy = 0;
-    QDBusConnection::disconnectFromPeer(QString::fromLatin1(IMServerConnection));
+    counters().add(Maliit::InputContext::ConnectionCounters::Disconnects);
+    MALIIT_TRACEPOINT1(disconnect, MALIIT_TRACEPOINT_NOW());
+    mDisconnectedAt = mClock->now();
+    mConnectClock.restart();
+    // Answers to abandoned updates are ignored, the next update sends the
+    // whole text
+    mSurroundingSynced = false;
+    mSurroundingPending = false;
+    mSurroundingDirty = true;
+    mUnacknowledgedCalls.clear();
+    abandonCalls();
+    stopHeartbeat();
+    if (mHandshake) {
+        disconnect(mHandshake, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                   this, SLOT(protocolNegotiated(QDBusPendingCallWatcher*)));
+        mHandshake->deleteLater();
+        mHandshake = 0;
+    }
+    mClock->cancel(this, SLOT(protocolNegotiationExpired()));
+    mConnecting = false;
+    if (mIntrospection) {
+        disconnect(mIntrospection, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                   this, SLOT(serverIntrospected(QDBusPendingCallWatcher*)));
+        mIntrospection->deleteLater();
+        mIntrospection = 0;
+    }
+    mProtocolVersion = 0;
+    mFeatures = ProtocolFeatures();
+    mInputStampTimes.clear();
+    mRegisteredExtensions.clear();
+    mAttributeFlushTimer.stop();
+    mPendingAttributes.clear();
+
+    // Deleted once its signal is handled
+    disconnect(mPeer, 0, this, 0);
+    mPeer->deleteLater();
+    mPeer = 0;
     Q_EMIT disconnected();
 
     if (mActive)
-        QTimer::singleShot(ConnectionRetryInterval, this, SLOT(connectToDBus()));
+        mClock->schedule(mRetryInterval, this, SLOT(connectToDBus()));
 }
 
-void DBusServerConnection::resetCallFinished(QDBusPendingCallWatcher *watcher)
+void DBusServerConnection::callFinished(QDBusPendingCallWatcher *watcher)
 {
-    pendingResetCalls.remove(watcher);
+    if (pendingResetCalls.remove(watcher)) {
+        counters().add(Maliit::InputContext::ConnectionCounters::PendingResets, -1);
+        MALIIT_TRACEPOINT2(reset_finish, static_cast<void *>(watcher), MALIIT_TRACEPOINT_NOW());
+    }
+    mInFlightCount -= mInFlightCalls.take(watcher);
+    const QList<OutgoingCall> acknowledged(mAcknowledgedCalls.take(watcher));
+    finishCompletions(mCompletions.take(watcher), !watcher->isError());
+    if (watcher->isError() && !acknowledged.isEmpty()) {
+        acknowledgementFailed(acknowledged, watcher->error());
+    }
     watcher->deleteLater();
+
+    drainQueues(false);
 }
 
 bool DBusServerConnection::pendingResets()
 {
-    return !pendingResetCalls.empty();
+    return !pendingResetCalls.empty() || mQueuedSynchronizedCalls > 0;
 }
 
-void DBusServerConnection::activateContext()
+void DBusServerConnection::countQueuedResets(int delta)
+{
+    // The gauge covers resets from the moment they are made, in flight ones
+    // are counted in dispatchCall()
+    mQueuedSynchronizedCalls += delta;
+    counters().add(Maliit::InputContext::ConnectionCounters::PendingResets, delta);
+}
+
+void DBusServerConnection::setPriorityLanesEnabled(bool enabled)
+{
+    mPriorityLanes = enabled;
+    if (!enabled) {
+        flushBulkLane();
+    }
+}
+
+bool DBusServerConnection::priorityLanesEnabled() const
+{
+    return mPriorityLanes;
+}
+
+QString DBusServerConnection::seat() const
+{
+    return mSeat;
+}
+
+void DBusServerConnection::setOneWayCallsEnabled(bool enabled)
+{
+    mOneWayCalls = enabled;
+}
+
+bool DBusServerConnection::oneWayCallsEnabled() const
+{
+    return mOneWayCalls;
+}
+
+void DBusServerConnection::setConnectionRetryInterval(int interval)
+{
+    mRetryInterval = qMax(0, interval);
+}
+
+int DBusServerConnection::connectionRetryInterval() const
+{
+    return mRetryInterval;
+}
+
+qint64 DBusServerConnection::recoveryTime() const
+{
+    return mRecoveryTime;
+}
+
+DBusServerConnection::ConnectTimings DBusServerConnection::connectTimings() const
+{
+    return mLastConnectTimings;
+}
+
+qint64 DBusServerConnection::phaseTime()
 {
-    if (!mProxy)
+    const qint64 now = mConnectClock.nsecsElapsed();
+    const qint64 duration = (now - mPhaseStart) / 1000;
+    mPhaseStart = now;
+    return duration;
+}
+
+void DBusServerConnection::setMaxInFlightCalls(int max)
+{
+    mMaxInFlightCalls = qMax(0, max);
+    drainQueues(true);
+}
+
+int DBusServerConnection::maxInFlightCalls() const
+{
+    return mMaxInFlightCalls;
+}
+
+DBusServerConnection::QueueStatistics DBusServerConnection::queueStatistics() const
+{
+    QueueStatistics statistics(mStatistics);
+    statistics.inFlightCalls = mInFlightCount + mUnacknowledgedCalls.size();
+    statistics.maxInFlightCalls = mMaxInFlightCalls;
+    statistics.queuedCriticalCalls = mCriticalLane.size();
+    statistics.queuedBulkCalls = mBulkLane.size();
+    return statistics;
+}
+
+QList<QVariant> &DBusServerConnection::scratchArguments(Call call, int count)
+{
+    // Each call keeps its argument list around.  Once the previous message
+    // has released it, it is overwritten in place instead of allocating a
+    // new list and new nodes for every message; if it is still shared,
+    // writing to it detaches as usual.
+    QList<QVariant> &arguments = mScratchArguments[call];
+    if (arguments.size() != count) {
+        arguments.clear();
+        for (int i = 0; i < count; ++i) {
+            arguments.append(QVariant());
+        }
+    }
+    return arguments;
+}
+
+void DBusServerConnection::sendCall(Lane lane, Call call, const QList<QVariant> &arguments,
+                                    bool synchronized, int payloadSize, const Completions &completions)
+{
+    if (!mPeer) {
+        mNextInputStamp = 0;
+        finishCompletions(completions, false);
         return;
+    }
 
-    mProxy->activateContext();
+    OutgoingCall outgoing(lane, call, arguments, synchronized,
+                          payloadSize < 0 ? Maliit::InputContext::ConnectionCounters::payloadSize(arguments) : payloadSize);
+    outgoing.completions = completions;
+    outgoing.stamp = mNextInputStamp;
+    outgoing.sequence = ++mMadeCalls[call];
+    mNextInputStamp = 0;
+
+    if (mCompoundDepth > 0 && mFeatures.testFlag(CompoundCallFeature)) {
+        // Same ordering as below, but everything ends up in one message.
+        // State updates are merged in the bulk lane until an ordered call
+        // takes them along, so no stale state follows a newer one.
+        if (lane == BulkLane && mPriorityLanes) {
+            queueBulkCall(outgoing);
+            return;
+        }
+        if (lane == OrderedLane) {
+            mCompound.append(mBulkLane);
+            mBulkLane.clear();
+            mBulkFlushTimer.stop();
+        }
+        if (outgoing.synchronized) {
+            countQueuedResets(1);
+        }
+        mCompound.append(outgoing);
+        return;
+    }
+
+    if (lane == BulkLane && mPriorityLanes) {
+        queueBulkCall(outgoing);
+        return;
+    }
+
+    // The server relies on state updates made so far when activating or
+    // showing, and when switching focus.
+    if (lane == OrderedLane) {
+        mCriticalLane.append(mBulkLane);
+        mBulkLane.clear();
+        mBulkFlushTimer.stop();
+    }
+
+    if (mCriticalLane.isEmpty() && !saturated()) {
+        dispatchCall(outgoing);
+        return;
+    }
+
+    queueCriticalCall(outgoing);
+    drainQueues(false);
 }
 
-void DBusServerConnection::showInputMethod()
+void DBusServerConnection::queueCriticalCall(const OutgoingCall &call)
 {
-    if (!mProxy)
+    if (call.stamp != 0) {
+        // The server reports the latency of the newest input, older queued
+        // input goes without a stamp
+        for (int i = mCriticalLane.size() - 1; i >= 0; --i) {
+            if (mCriticalLane.at(i).stamp != 0) {
+                mCriticalLane[i].stamp = 0;
+                break;
+            }
+        }
+    }
+
+    // Only the latest preedit matters to a server that has not caught up yet
+    if (!mCriticalLane.isEmpty() && call.call == SetPreeditCall
+        && mCriticalLane.last().call == call.call) {
+        mCriticalLane.last().arguments = call.arguments;
+        mCriticalLane.last().payloadSize = call.payloadSize;
+        mCriticalLane.last().completions += call.completions;
+        mCriticalLane.last().sequence = call.sequence;
+        if (call.stamp != 0) {
+            mCriticalLane.last().stamp = call.stamp;
+        }
+        ++mStatistics.mergedCalls;
         return;
+    }
+
+    if (mCriticalLane.size() >= MaxQueuedCriticalCalls) {
+        // The queued state update of the same kind is stale once this one
+        // is sent
+        if (supersedes(call.call)) {
+            for (int i = 0; i < mCriticalLane.size(); ++i) {
+                if (mCriticalLane.at(i).call != call.call)
+                    continue;
+
+                const OutgoingCall stale(mCriticalLane.takeAt(i));
+                if (stale.synchronized) {
+                    countQueuedResets(-1);
+                }
+                OutgoingCall latest(call);
+                latest.completions = stale.completions + call.completions;
+                if (latest.synchronized) {
+                    countQueuedResets(1);
+                }
+                mCriticalLane.append(latest);
+                ++mStatistics.mergedCalls;
+                return;
+            }
+        }
+
+        // A server this far behind is better off without the oldest input
+        // than with an ever growing backlog; resets and registrations are
+        // never given up on, if nothing else is queued the new call fails.
+        ++mStatistics.droppedCalls;
+        counters().add(Maliit::InputContext::ConnectionCounters::QueueOverflows);
+        int oldest = 0;
+        while (oldest < mCriticalLane.size() && !droppable(mCriticalLane.at(oldest).call)) {
+            ++oldest;
+        }
+        if (oldest == mCriticalLane.size()) {
+            finishCompletions(call.completions, false);
+            return;
+        }
 
-    mProxy->showInputMethod();
+        const OutgoingCall dropped(mCriticalLane.takeAt(oldest));
+        if (dropped.synchronized) {
+            countQueuedResets(-1);
+        }
+        if (call.synchronized) {
+            countQueuedResets(1);
+        }
+        mCriticalLane.append(call);
+        // Callbacks may queue further calls, the lane is consistent again
+        finishCompletions(dropped.completions, false);
+        return;
+    }
+
+    if (call.synchronized) {
+        countQueuedResets(1);
+    }
+    mCriticalLane.append(call);
 }
 
-void DBusServerConnection::hideInputMethod()
+bool DBusServerConnection::supersedes(Call call)
+{
+    switch (call) {
+    case SetPreeditCall:
+    case AppOrientationAboutToChangeCall:
+    case AppOrientationChangedCall:
+    case SetCopyPasteStateCall:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool DBusServerConnection::droppable(Call call)
+{
+    switch (call) {
+    case MouseClickedOnPreeditCall:
+    case SetPreeditCall:
+    case AppOrientationAboutToChangeCall:
+    case AppOrientationChangedCall:
+    case SetCopyPasteStateCall:
+    case ProcessKeyEventCall:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool DBusServerConnection::resendable(Call call)
+{
+    switch (call) {
+    case UpdateWidgetInformationCall:
+    case AppOrientationChangedCall:
+    case SetCopyPasteStateCall:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void DBusServerConnection::acknowledgementFailed(const QList<OutgoingCall> &calls, const QDBusError &error)
+{
+    // The server answers one-way calls not even with an error, whether it
+    // handled them is unknown.  Complete state is sent again, with a reply
+    // of its own to tell which call fails; input is not repeated.
+    qWarning() << "Maliit: acknowledgement of" << calls.size() << "one-way calls failed:" << error.message();
+
+    Q_FOREACH (const OutgoingCall &call, calls) {
+        if (!mPeer || !resendable(call.call)) {
+            ++mStatistics.lostCalls;
+            counters().add(Maliit::InputContext::ConnectionCounters::LostCalls);
+            continue;
+        }
+        // A newer update of the same kind is on its way already
+        if (mMadeCalls[call.call] != call.sequence)
+            continue;
+
+        const Maliit::InputContext::Completion retry;
+        const char * const method = CallNames[call.call];
+        retry.then([method](bool succeeded) {
+            if (!succeeded) {
+                qWarning() << "Maliit: server failed" << method;
+            }
+        });
+        sendCall(call.lane == OrderedLane ? CriticalLane : call.lane, call.call, call.arguments,
+                 false, call.payloadSize, Completions() << retry);
+    }
+}
+
+void DBusServerConnection::queueBulkCall(const OutgoingCall &call)
 {
-    if (!mProxy)
+    // A newer state update supersedes the queued one of the same kind
+    for (QList<OutgoingCall>::iterator it = mBulkLane.begin(); it != mBulkLane.end(); ++it) {
+        if (it->call == call.call) {
+            it->arguments = call.arguments;
+            it->payloadSize = call.payloadSize;
+            it->completions += call.completions;
+            it->sequence = call.sequence;
+            ++mStatistics.mergedCalls;
+            return;
+        }
+    }
+
+    mBulkLane.append(call);
+    if (!mBulkFlushTimer.isActive()) {
+        mBulkFlushTimer.start();
+    }
+}
+
+void DBusServerConnection::drainQueues(bool includeBulk)
+{
+    if (!mPeer) {
+        clearQueues();
         return;
+    }
 
-    mProxy->hideInputMethod();
+    while (!mCriticalLane.isEmpty() && !saturated()) {
+        const OutgoingCall call(mCriticalLane.takeFirst());
+        if (call.synchronized) {
+            countQueuedResets(-1);
+        }
+        dispatchCall(call);
+    }
+
+    if (!mCriticalLane.isEmpty()) {
+        return;
+    }
+
+    if (includeBulk) {
+        while (!mBulkLane.isEmpty() && !saturated()) {
+            dispatchCall(mBulkLane.takeFirst());
+        }
+    } else if (!mBulkLane.isEmpty() && !mBulkFlushTimer.isActive()) {
+        mBulkFlushTimer.start();
+    }
+}
+
+void DBusServerConnection::dispatchCall(const OutgoingCall &call)
+{
+    if (call.stamp != 0) {
+        OutgoingCall stamped(call);
+        stamped.stamp = 0;
+        if (!mFeatures.testFlag(CompoundCallFeature)) {
+            const QList<QVariant> arguments(stampArguments(call.stamp));
+            dispatchCall(OutgoingCall(call.lane, InputStampCall, arguments, false,
+                                      Maliit::InputContext::ConnectionCounters::payloadSize(arguments)));
+            dispatchCall(stamped);
+            return;
+        }
+
+        // The stamp rides in the same message as the input
+        QList<CompoundCallEntry> entries;
+        CompoundCallEntry entry;
+        entry.method = metadata().methodNames[InputStampCall];
+        entry.arguments = stampArguments(call.stamp);
+        entries.append(entry);
+        entry.method = metadata().methodNames[call.call];
+        entry.arguments = call.arguments;
+        entries.append(entry);
+
+        const int payloadSize = 4 + 5 + entries.first().method.size()
+            + Maliit::InputContext::ConnectionCounters::payloadSize(entries.first().arguments)
+            + 5 + entry.method.size() + call.payloadSize;
+        OutgoingCall compound(call.lane, CompoundCall, QList<QVariant>() << QVariant::fromValue(entries),
+                              call.synchronized, payloadSize);
+        compound.completions = call.completions;
+        dispatchCall(compound);
+        return;
+    }
+
+    Maliit::InputContext::TraceSpan span(CallNames[call.call], "outgoing");
+    counters().countMessage(countedMethod(call.call), Maliit::InputContext::ConnectionCounters::Sent, call.payloadSize);
+    MALIIT_TRACEPOINT3(outgoing_call, CallNames[call.call], call.payloadSize, MALIIT_TRACEPOINT_NOW());
+
+    // A failing server is noticed through the acknowledgement also when
+    // the calls in flight are not limited
+    const int interval = mMaxInFlightCalls > 0 ? qMin(AcknowledgementInterval, mMaxInFlightCalls)
+                                               : AcknowledgementInterval;
+    const bool awaited = call.synchronized || !call.completions.isEmpty();
+    const bool acknowledge = mUnacknowledgedCalls.size() + 1 >= interval;
+    if (mOneWayCalls && !awaited && !acknowledge) {
+        // Sending without a pending call marks the message as expecting no reply
+        QDBusMessage message = serverCall(metadata().methodNames[call.call]);
+        message.setArguments(call.arguments);
+        mPeer->send(message);
+        mUnacknowledgedCalls.append(call);
+        mStatistics.peakInFlightCalls = qMax(mStatistics.peakInFlightCalls,
+                                             mInFlightCount + mUnacknowledgedCalls.size());
+        return;
+    }
+
+    QDBusMessage message = serverCall(metadata().methodNames[call.call]);
+    message.setArguments(call.arguments);
+    QDBusPendingCallWatcher *watcher = mPeer->call(message, this);
+
+    if (call.synchronized) {
+        pendingResetCalls.insert(watcher);
+        counters().add(Maliit::InputContext::ConnectionCounters::PendingResets);
+        MALIIT_TRACEPOINT2(reset_start, static_cast<void *>(watcher), MALIIT_TRACEPOINT_NOW());
+    }
+    // The reply also covers the one-way calls sent before
+    mInFlightCalls.insert(watcher, mUnacknowledgedCalls.size() + 1);
+    mInFlightCount += mUnacknowledgedCalls.size() + 1;
+    if (!mUnacknowledgedCalls.isEmpty()) {
+        mAcknowledgedCalls.insert(watcher, mUnacknowledgedCalls);
+        mUnacknowledgedCalls.clear();
+    }
+    mStatistics.peakInFlightCalls = qMax(mStatistics.peakInFlightCalls, mInFlightCount);
+    if (!call.completions.isEmpty()) {
+        mCompletions.insert(watcher, call.completions);
+    }
+    QObject::connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                     this, SLOT(callFinished(QDBusPendingCallWatcher*)));
+}
+
+bool DBusServerConnection::saturated() const
+{
+    if (mMaxInFlightCalls <= 0)
+        return false;
+
+    // One-way calls are only acknowledged by a later call, which must fit
+    // under the cap, also after it was lowered
+    const int unacknowledged = qMin(mUnacknowledgedCalls.size(), mMaxInFlightCalls - 1);
+    return mInFlightCount + unacknowledged >= mMaxInFlightCalls;
+}
+
+void DBusServerConnection::clearQueues()
+{
+    finishCompletions(takeQueuedCompletions(), false);
+}
+
+DBusServerConnection::Completions DBusServerConnection::takeQueuedCompletions()
+{
+    mBulkFlushTimer.stop();
+    mStatistics.droppedCalls += mCriticalLane.size() + mBulkLane.size();
+
+    Completions completions;
+    Q_FOREACH (const OutgoingCall &call, mCriticalLane + mBulkLane + mCompound) {
+        completions += call.completions;
+    }
+    mCriticalLane.clear();
+    mBulkLane.clear();
+    mCompound.clear();
+    countQueuedResets(-mQueuedSynchronizedCalls);
+    return completions;
+}
+
+void DBusServerConnection::abandonCalls()
+{
+    // Everything is taken out before the callbacks run, calls they make
+    // are kept
+    const QList<Completions> inFlight(mCompletions.values());
+    mCompletions.clear();
+    const Completions queued(takeQueuedCompletions());
+
+    Q_FOREACH (const Completions &completions, inFlight) {
+        finishCompletions(completions, false);
+    }
+    finishCompletions(queued, false);
+}
+
+void DBusServerConnection::flushBulkLane()
+{
+    mBulkFlushTimer.stop();
+    drainQueues(true);
+}
+
+void DBusServerConnection::setHeartbeat(int interval, int budget)
+{
+    interval = qMax(0, interval);
+    if (interval > 0 && budget <= 0) {
+        // A zero budget would declare the server unresponsive on every probe
+        budget = interval;
+    }
+    mHeartbeatInterval = interval;
+    mHeartbeatBudget = qMax(0, budget);
+
+    stopHeartbeat();
+    if (mPeer) {
+        startHeartbeat();
+    }
+}
+
+int DBusServerConnection::serverResponseTime() const
+{
+    return mServerResponseTime;
+}
+
+bool DBusServerConnection::isServerResponsive() const
+{
+    return mServerResponsive;
+}
+
+void DBusServerConnection::startHeartbeat()
+{
+    mServerResponsive = true;
+    if (mHeartbeatInterval > 0) {
+        mClock->schedule(mHeartbeatInterval, this, SLOT(sendHeartbeat()));
+    }
+}
+
+void DBusServerConnection::stopHeartbeat()
+{
+    mClock->cancel(this, SLOT(sendHeartbeat()));
+    mClock->cancel(this, SLOT(heartbeatExpired()));
+    if (mHeartbeat) {
+        disconnect(mHeartbeat, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                   this, SLOT(heartbeatFinished(QDBusPendingCallWatcher*)));
+        mHeartbeat->deleteLater();
+        mHeartbeat = 0;
+    }
+}
+
+void DBusServerConnection::sendHeartbeat()
+{
+    if (!mPeer)
+        return;
+    mClock->schedule(mHeartbeatInterval, this, SLOT(sendHeartbeat()));
+
+    // A probe is still waiting for its answer, the budget judges it
+    if (mHeartbeat)
+        return;
+
+    // Peer.Ping would be answered by libdbus even when the server's main
+    // loop is wedged, property calls on the server object are handled by
+    // the same thread that handles input.
+    QDBusMessage probe = QDBusMessage::createMethodCall(QString(), metadata().serverPath,
+                                                        QString::fromLatin1(DBusPropertiesInterface),
+                                                        QString::fromLatin1(DBusPropertiesGetAllMethod));
+    probe << QString::fromLatin1(ComMeegoInputmethodUiserver1Interface::staticInterfaceName());
+
+    mHeartbeatSentAt = mClock->now();
+    mHeartbeat = mPeer->call(probe, this);
+    connect(mHeartbeat, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(heartbeatFinished(QDBusPendingCallWatcher*)));
+    if (mServerResponsive) {
+        mClock->schedule(mHeartbeatBudget, this, SLOT(heartbeatExpired()));
+    }
+}
+
+void DBusServerConnection::heartbeatFinished(QDBusPendingCallWatcher *watcher)
+{
+    mHeartbeat = 0;
+    watcher->deleteLater();
+    mClock->cancel(this, SLOT(heartbeatExpired()));
+
+    // Any answer, even an error, proves that the server is handling messages
+    const QDBusError::ErrorType error = watcher->error().type();
+    if (error == QDBusError::NoReply || error == QDBusError::Disconnected) {
+        heartbeatExpired();
+        return;
+    }
+
+    mServerResponseTime = mClock->now() - mHeartbeatSentAt;
+    if (!mServerResponsive) {
+        mServerResponsive = true;
+        Q_EMIT serverResponsive();
+    }
+}
+
+void DBusServerConnection::heartbeatExpired()
+{
+    if (!mServerResponsive)
+        return;
+
+    mServerResponsive = false;
+    Q_EMIT serverUnresponsive();
+}
+
+bool DBusServerConnection::negotiateProtocol()
+{
+    const ProtocolFeatures supported(CompoundCallFeature | InputStampFeature | SurroundingTextFeature);
+    QDBusMessage handshake = serverCall(QString::fromLatin1(NegotiateProtocolMethod));
+    handshake << ProtocolVersion << static_cast<uint>(supported);
+    mHandshake = mPeer->call(handshake, this);
+    connect(mHandshake, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(protocolNegotiated(QDBusPendingCallWatcher*)));
+
+    // Until the reply arrives only the base protocol is spoken: the server
+    // behind a known address may have been replaced by one lacking features,
+    // and one-way calls to methods it does not have fail silently.  A
+    // server that answered before does not hold connected() back though.
+    setProtocol(0, ProtocolFeatures(), QString());
+
+    QMutexLocker locker(negotiatedServersMutex());
+    if (negotiatedServers()->contains(mServerAddress))
+        return true;
+    locker.unlock();
+
+    mClock->schedule(ProtocolNegotiationTimeout, this, SLOT(protocolNegotiationExpired()));
+    return false;
+}
+
+void DBusServerConnection::protocolNegotiated(QDBusPendingCallWatcher *watcher)
+{
+    mHandshake = 0;
+    watcher->deleteLater();
+
+    QDBusPendingReply<uint, uint, QString> reply(*watcher);
+    if (reply.isError()) {
+        if (reply.error().name() == QLatin1String(DBusUnknownMethodError)) {
+            // Servers predating the handshake list their methods instead,
+            // connecting waits for that answer
+            introspectServer();
+            return;
+        }
+
+        qWarning() << "Maliit: protocol negotiation failed:" << reply.error().message();
+        QMutexLocker locker(negotiatedServersMutex());
+        negotiatedServers()->remove(mServerAddress);
+        locker.unlock();
+        setProtocol(0, ProtocolFeatures(), QString());
+    } else {
+        const ProtocolFeatures supported(CompoundCallFeature | InputStampFeature | SurroundingTextFeature);
+        QMutexLocker locker(negotiatedServersMutex());
+        negotiatedServers()->insert(mServerAddress);
+        locker.unlock();
+        setProtocol(qMin(reply.argumentAt<0>(), ProtocolVersion),
+                    ProtocolFeatures(reply.argumentAt<1>()) & supported, reply.argumentAt<2>());
+    }
+
+    if (mConnecting) {
+        mClock->cancel(this, SLOT(protocolNegotiationExpired()));
+        finishConnecting();
+    }
+}
+
+void DBusServerConnection::protocolNegotiationExpired()
+{
+    // Do not hold the application back any longer, the reply still counts
+    // once it arrives.
+    if (mConnecting) {
+        qWarning() << "Maliit: no answer to protocol negotiation, connecting without";
+        finishConnecting();
+    }
+}
+
+void DBusServerConnection::setProtocol(uint version, ProtocolFeatures features, const QString &serverVersion)
+{
+    mProtocolVersion = version;
+    mFeatures = features;
+    if (!serverVersion.isEmpty()) {
+        mServerVersion = serverVersion;
+    }
+}
+
+DBusServerConnection::ProtocolFeatures DBusServerConnection::protocolFeatures() const
+{
+    return mFeatures;
+}
+
+uint DBusServerConnection::protocolVersion() const
+{
+    return mProtocolVersion;
+}
+
+void DBusServerConnection::introspectServer()
+{
+    // Until the answer arrives compound calls are sent one by one
+    QDBusMessage introspect = QDBusMessage::createMethodCall(QString(), metadata().serverPath,
+                                                             QString::fromLatin1(DBusIntrospectableInterface),
+                                                             QString::fromLatin1(DBusIntrospectMethod));
+    mIntrospection = mPeer->call(introspect, this);
+    connect(mIntrospection, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(serverIntrospected(QDBusPendingCallWatcher*)));
+}
+
+void DBusServerConnection::serverIntrospected(QDBusPendingCallWatcher *watcher)
+{
+    mIntrospection = 0;
+    watcher->deleteLater();
+
+    QDBusPendingReply<QString> reply(*watcher);
+    if (reply.isError()) {
+        qWarning() << "Maliit: introspecting the server failed:" << reply.error().message();
+        if (mConnecting) {
+            mClock->cancel(this, SLOT(protocolNegotiationExpired()));
+            finishConnecting();
+        }
+        return;
+    }
+
+    ProtocolFeatures features;
+    if (reply.value().contains(QLatin1String(CompoundCallIntrospection)))
+        features |= CompoundCallFeature;
+    if (reply.value().contains(QLatin1String(InputStampIntrospection)))
+        features |= InputStampFeature;
+    if (reply.value().contains(QLatin1String(SurroundingTextIntrospection)))
+        features |= SurroundingTextFeature;
+
+    QMutexLocker locker(negotiatedServersMutex());
+    negotiatedServers()->insert(mServerAddress);
+    locker.unlock();
+
+    // The server does not report a version, its interface is the closest
+    // thing to one: it identifies the settings description cached for it.
+    setProtocol(0, features,
+                QString::fromLatin1(QCryptographicHash::hash(reply.value().toUtf8(),
+                                                             QCryptographicHash::Sha1).toHex()));
+
+    if (mConnecting) {
+        mClock->cancel(this, SLOT(protocolNegotiationExpired()));
+        finishConnecting();
+    }
+}
+
+void DBusServerConnection::registerAttributeExtension(int id, const QString &fileName)
+{
+    if (mAttributeExtensions.contains(id))
+        return;
+
+    mAttributeExtensions.insert(id, fileName);
+    registerAttributeExtensions();
+}
+
+void DBusServerConnection::unregisterAttributeExtension(int id)
+{
+    if (!mAttributeExtensions.remove(id))
+        return;
+
+    for (QHash<QString, ExtendedAttribute>::iterator it = mExtendedAttributes.begin();
+         it != mExtendedAttributes.end();) {
+        if (it->id == id) {
+            mPendingAttributes.removeOne(it.key());
+            it = mExtendedAttributes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!mRegisteredExtensions.remove(id) || !mPeer)
+        return;
+
+    Maliit::InputContext::AllocationScope scope(CallNames[UnregisterAttributeExtensionCall]);
+    QList<QVariant> &arguments = scratchArguments(UnregisterAttributeExtensionCall, 1);
+    arguments[0] = id;
+    sendCall(CriticalLane, UnregisterAttributeExtensionCall, arguments);
+}
+
+void DBusServerConnection::registerAttributeExtensions()
+{
+    if (!mPeer)
+        return;
+
+    QList<int> unregistered;
+    for (QHash<int, QString>::const_iterator it = mAttributeExtensions.constBegin();
+         it != mAttributeExtensions.constEnd(); ++it) {
+        if (!mRegisteredExtensions.contains(it.key())) {
+            mRegisteredExtensions.insert(it.key());
+            unregistered.append(it.key());
+        }
+    }
+
+    Q_FOREACH (int id, unregistered) {
+        Maliit::InputContext::AllocationScope scope(CallNames[RegisterAttributeExtensionCall]);
+        QList<QVariant> &arguments = scratchArguments(RegisterAttributeExtensionCall, 2);
+        arguments[0] = id;
+        arguments[1] = mAttributeExtensions.value(id);
+        sendCall(CriticalLane, RegisterAttributeExtensionCall, arguments);
+    }
+
+    // A restarted server has lost the attributes set so far
+    mPendingAttributes = mExtendedAttributes.keys();
+    if (!mPendingAttributes.isEmpty()) {
+        mAttributeFlushTimer.start();
+    }
+}
+
+void DBusServerConnection::setExtendedAttribute(int id, const QString &target, const QString &targetItem,
+                                                const QString &attribute, const QVariant &value)
+{
+    if (!mAttributeExtensions.contains(id))
+        return;
+
+    const QString key(attributeKey(id, target, targetItem, attribute));
+    QHash<QString, ExtendedAttribute>::iterator it = mExtendedAttributes.find(key);
+    if (it != mExtendedAttributes.end()) {
+        if (it->value == value)
+            return;
+        it->value = value;
+    } else {
+        ExtendedAttribute extendedAttribute = { id, target, targetItem, attribute, value };
+        mExtendedAttributes.insert(key, extendedAttribute);
+    }
+
+    if (!mPendingAttributes.contains(key)) {
+        mPendingAttributes.append(key);
+    }
+    if (mPeer && !mAttributeFlushTimer.isActive()) {
+        mAttributeFlushTimer.start();
+    }
+}
+
+void DBusServerConnection::flushExtendedAttributes()
+{
+    if (!mPeer) {
+        mPendingAttributes.clear();
+        return;
+    }
+
+    beginCompoundCall();
+    Q_FOREACH (const QString &key, mPendingAttributes) {
+        const ExtendedAttribute &attribute = mExtendedAttributes[key];
+
+        Maliit::InputContext::AllocationScope scope(CallNames[SetExtendedAttributeCall]);
+        QList<QVariant> &arguments = scratchArguments(SetExtendedAttributeCall, 5);
+        arguments[0] = attribute.id;
+        arguments[1] = attribute.target;
+        arguments[2] = attribute.targetItem;
+        arguments[3] = attribute.attribute;
+        arguments[4] = QVariant::fromValue(QDBusVariant(attribute.value));
+        sendCall(CriticalLane, SetExtendedAttributeCall, arguments);
+    }
+    mPendingAttributes.clear();
+    endCompoundCall();
+}
+
+void DBusServerConnection::loadPluginSettings(const QString &descriptionLanguage)
+{
+    if (descriptionLanguage != mPluginSettingsLanguage) {
+        mPluginSettingsLanguage = descriptionLanguage;
+        mPluginSettings.clear();
+        mPluginSettingsDelivered = false;
+
+        QString cachedServerVersion;
+        QList<MImPluginSettingsInfo> cached;
+        if (Maliit::InputContext::PluginSettingsCache::load(descriptionLanguage, cachedServerVersion, cached)
+            && (mServerVersion.isEmpty() || cachedServerVersion == mServerVersion)) {
+            mPluginSettings = cached;
+        }
+    }
+
+    // Served without waiting for the server, which is asked for changes below
+    if (!mPluginSettings.isEmpty()) {
+        QTimer::singleShot(0, this, SLOT(deliverPluginSettings()));
+    }
+
+    requestPluginSettings();
+}
+
+void DBusServerConnection::requestPluginSettings()
+{
+    if (!mPeer || mPluginSettingsLanguage.isNull())
+        return;
+
+    mPluginSettingsRequested = true;
+
+    Maliit::InputContext::AllocationScope scope(CallNames[LoadPluginSettingsCall]);
+    QList<QVariant> &arguments = scratchArguments(LoadPluginSettingsCall, 1);
+    arguments[0] = mPluginSettingsLanguage;
+    sendCall(BulkLane, LoadPluginSettingsCall, arguments);
+}
+
+void DBusServerConnection::deliverPluginSettings()
+{
+    mPluginSettingsDelivered = true;
+    Q_EMIT pluginSettingsReceived(mPluginSettings);
+}
+
+void DBusServerConnection::pluginSettingsLoaded(const QList<MImPluginSettingsInfo> &info)
+{
+    // Answers to loadPluginSettings() are complete, anything else the
+    // server sends on its own only carries the plugins that changed.
+    const bool complete = mPluginSettingsRequested;
+    mPluginSettingsRequested = false;
+
+    if (mPluginSettingsLanguage.isNull() && !info.isEmpty()) {
+        mPluginSettingsLanguage = info.first().description_language;
+    }
+
+    const bool changed = Maliit::InputContext::PluginSettingsCache::merge(mPluginSettings, info, complete);
+    if (!changed && mPluginSettingsDelivered)
+        return;
+
+    Maliit::InputContext::PluginSettingsCache::store(mPluginSettingsLanguage, mServerVersion, mPluginSettings);
+    deliverPluginSettings();
+}
+
+void DBusServerConnection::beginCompoundCall()
+{
+    ++mCompoundDepth;
+}
+
+void DBusServerConnection::endCompoundCall()
+{
+    if (mCompoundDepth == 0 || --mCompoundDepth > 0)
+        return;
+
+    const QList<OutgoingCall> calls(mCompound);
+    mCompound.clear();
+    if (calls.isEmpty())
+        return;
+
+    // Counted again by sendCall() below, once for the whole compound
+    Q_FOREACH (const OutgoingCall &call, calls) {
+        if (call.synchronized) {
+            countQueuedResets(-1);
+        }
+    }
+
+    if (calls.size() == 1) {
+        // An ordered call took the bulk lane along when it was made, what
+        // is queued there now came later
+        const OutgoingCall &call = calls.first();
+        mNextInputStamp = call.stamp;
+        sendCall(call.lane == OrderedLane ? CriticalLane : call.lane, call.call, call.arguments,
+                 call.synchronized, call.payloadSize, call.completions);
+        return;
+    }
+
+    Maliit::InputContext::AllocationScope scope(CallNames[CompoundCall]);
+    QList<CompoundCallEntry> entries;
+    bool synchronized = false;
+    int payloadSize = 4;
+    Completions completions;
+    Q_FOREACH (const OutgoingCall &call, calls) {
+        if (call.stamp != 0) {
+            CompoundCallEntry stamp;
+            stamp.method = metadata().methodNames[InputStampCall];
+            stamp.arguments = stampArguments(call.stamp);
+            entries.append(stamp);
+            payloadSize += 5 + stamp.method.size()
+                + Maliit::InputContext::ConnectionCounters::payloadSize(stamp.arguments);
+        }
+
+        CompoundCallEntry entry;
+        entry.method = metadata().methodNames[call.call];
+        entry.arguments = call.arguments;
+        entries.append(entry);
+        synchronized = synchronized || call.synchronized;
+        payloadSize += 5 + entry.method.size() + call.payloadSize;
+        completions += call.completions;
+    }
+
+    QList<QVariant> &arguments = scratchArguments(CompoundCall, 1);
+    arguments[0] = QVariant::fromValue(entries);
+    sendCall(CriticalLane, CompoundCall, arguments, synchronized, payloadSize, completions);
+}
+
+void DBusServerConnection::activateContext()
+{
+    sendActivateContext(Completions());
+}
+
+Maliit::InputContext::Completion DBusServerConnection::activateContextAsync()
+{
+    const Maliit::InputContext::Completion completion;
+    sendActivateContext(Completions() << completion);
+    return completion;
+}
+
+void DBusServerConnection::sendActivateContext(const Completions &completions)
+{
+    Maliit::InputContext::AllocationScope scope(CallNames[ActivateContextCall]);
+    sendCall(OrderedLane, ActivateContextCall, scratchArguments(ActivateContextCall, 0), false, -1, completions);
+}
+
+void DBusServerConnection::showInputMethod()
+{
+    Maliit::InputContext::AllocationScope scope(CallNames[ShowInputMethodCall]);
+    sendCall(OrderedLane, ShowInputMethodCall, scratchArguments(ShowInputMethodCall, 0));
+}
+
+void DBusServerConnection::hideInputMethod()
+{
+    Maliit::InputContext::AllocationScope scope(CallNames[HideInputMethodCall]);
+    sendCall(CriticalLane, HideInputMethodCall, scratchArguments(HideInputMethodCall, 0));
 }
 
 void DBusServerConnection::mouseClickedOnPreedit(const QPoint &pos, const QRect &preeditRect)
 {
-    if (!mProxy)
+    if (!mPeer)
         return;
 
-    mProxy->mouseClickedOnPreedit(pos.x(), pos.y(), preeditRect.x(), preeditRect.y(),
-                                  preeditRect.width(), preeditRect.height());
+    Maliit::InputContext::AllocationScope scope(CallNames[MouseClickedOnPreeditCall]);
+    stampInput();
+    QList<QVariant> &arguments = scratchArguments(MouseClickedOnPreeditCall, 6);
+    arguments[0] = pos.x();
+    arguments[1] = pos.y();
+    arguments[2] = preeditRect.x();
+    arguments[3] = preeditRect.y();
+    arguments[4] = preeditRect.width();
+    arguments[5] = preeditRect.height();
+    sendCall(CriticalLane, MouseClickedOnPreeditCall, arguments);
 }
 
 void DBusServerConnection::setPreedit(const QString &text, int cursorPos)
 {
-    if (!mProxy)
+    if (!mPeer)
         return;
 
-    mProxy->setPreedit(text, cursorPos);
+    Maliit::InputContext::AllocationScope scope(CallNames[SetPreeditCall]);
+    stampInput();
+    QList<QVariant> &arguments = scratchArguments(SetPreeditCall, 2);
+    arguments[0] = text;
+    arguments[1] = cursorPos;
+    sendCall(CriticalLane, SetPreeditCall, arguments);
 }
 
 void DBusServerConnection::updateWidgetInformation(const QMap<QString, QVariant> &stateInformation, bool focusChanged)
 {
-    if (!mProxy)
+    sendWidgetInformation(stateInformation, focusChanged, Completions());
+}
+
+Maliit::InputContext::Completion DBusServerConnection::updateWidgetInformationAsync(const QMap<QString, QVariant> &stateInformation,
+                                                                                    bool focusChanged)
+{
+    const Maliit::InputContext::Completion completion;
+    sendWidgetInformation(stateInformation, focusChanged, Completions() << completion);
+    return completion;
+}
+
+void DBusServerConnection::sendWidgetInformation(const QMap<QString, QVariant> &stateInformation, bool focusChanged,
+                                                 const Completions &completions)
+{
+    if (!mPeer) {
+        finishCompletions(completions, false);
         return;
+    }
+
+    Maliit::InputContext::AllocationScope scope(CallNames[UpdateWidgetInformationCall]);
+
+    // The text goes its own way, as the difference to what the server has
+    QMap<QString, QVariant> information(stateInformation);
+    if (mFeatures.testFlag(SurroundingTextFeature)) {
+        const QMap<QString, QVariant>::iterator text = information.find(QLatin1String(SurroundingTextKey));
+        if (text != information.end()) {
+            const int cursor = information.value(QLatin1String(CursorPositionKey), -1).toInt();
+            const int anchor = information.value(QLatin1String(AnchorPositionKey), cursor).toInt();
+            syncSurroundingText(text->toString(), cursor, anchor, focusChanged);
+            information.erase(text);
+        }
+    }
 
-    mProxy->updateWidgetInformation(stateInformation, focusChanged);
+    QList<QVariant> &arguments = scratchArguments(UpdateWidgetInformationCall, 2);
+    arguments[0] = ComMeegoInputmethodUiserver1Interface::stateInformationArgument(information);
+    arguments[1] = focusChanged;
+    const Lane lane = focusChanged ? OrderedLane : BulkLane;
+    sendCall(lane, UpdateWidgetInformationCall, arguments, false,
+             Maliit::InputContext::ConnectionCounters::payloadSize(QVariant(information)) + 4, completions);
+
+    // The text follows the focus change and state it belongs to
+    flushSurroundingText(lane);
 }
 
-void DBusServerConnection::reset(bool requireSynchronization)
+void DBusServerConnection::updateSurroundingText(int start, int length, const QString &text, int cursor, int anchor)
 {
-    if (!mProxy)
+    start = qBound(0, start, mSurroundingText.size());
+    length = qBound(0, length, mSurroundingText.size() - start);
+    noteSurroundingEdit(start, length, mSurroundingText.size());
+    mSurroundingText.replace(start, length, text);
+    mSurroundingCursor = cursor;
+    mSurroundingAnchor = anchor;
+
+    flushSurroundingText(BulkLane);
+}
+
+void DBusServerConnection::resendSurroundingText()
+{
+    mSurroundingSynced = false;
+    mSurroundingDirty = true;
+    flushSurroundingText(OrderedLane);
+}
+
+void DBusServerConnection::syncSurroundingText(const QString &text, int cursor, int anchor, bool full)
+{
+    if (full || !mSurroundingSynced) {
+        mSurroundingText = text;
+        mSurroundingCursor = cursor;
+        mSurroundingAnchor = anchor;
+        mSurroundingSynced = false;
+        mSurroundingDirty = true;
         return;
+    }
 
-    QDBusPendingCall resetCall = mProxy->reset();
-    if (requireSynchronization) {
-        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(resetCall, this);
-        pendingResetCalls.insert(watcher);
-        QObject::connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
-                         this, SLOT(resetCallFinished(QDBusPendingCallWatcher*)));
+    // Texts shared with the last update compare without touching their data
+    int prefix = 0;
+    int suffix = 0;
+    if (text.constData() != mSurroundingText.constData() || text.size() != mSurroundingText.size()) {
+        const int common = qMin(text.size(), mSurroundingText.size());
+        const QChar *from = mSurroundingText.constData();
+        const QChar *to = text.constData();
+        while (prefix < common && from[prefix] == to[prefix]) {
+            ++prefix;
+        }
+        while (suffix < common - prefix
+               && from[mSurroundingText.size() - 1 - suffix] == to[text.size() - 1 - suffix]) {
+            ++suffix;
+        }
+    } else {
+        prefix = text.size();
+    }
+
+    const int length = mSurroundingText.size() - prefix - suffix;
+    const QString inserted(text.mid(prefix, text.size() - prefix - suffix));
+    if (length == 0 && inserted.isEmpty() && cursor == mSurroundingCursor && anchor == mSurroundingAnchor) {
+        return;
     }
+
+    noteSurroundingEdit(prefix, length, mSurroundingText.size());
+    mSurroundingText = text;
+    mSurroundingCursor = cursor;
+    mSurroundingAnchor = anchor;
+}
+
+void DBusServerConnection::noteSurroundingEdit(int start, int length, int size)
+{
+    // Edits waiting for the server's answer become one, spanning them all
+    const int suffix = size - start - length;
+    if (!mSurroundingDirty) {
+        mSurroundingDirty = true;
+        mSurroundingPrefix = start;
+        mSurroundingSuffix = suffix;
+        return;
+    }
+    mSurroundingPrefix = qMin(mSurroundingPrefix, start);
+    mSurroundingSuffix = qMin(mSurroundingSuffix, suffix);
+}
+
+void DBusServerConnection::flushSurroundingText(Lane lane)
+{
+    if (!mPeer || !mFeatures.testFlag(SurroundingTextFeature) || !mSurroundingDirty)
+        return;
+
+    if (!mSurroundingSynced) {
+        // Revision 0 replaces whatever the server has, a length of -1
+        // stands for the whole text; no need to wait for earlier answers
+        sendSurroundingText(lane, 0, 0, -1, mSurroundingText);
+        return;
+    }
+
+    if (mSurroundingPending)
+        return;
+
+    const int length = mSurroundingSentSize - mSurroundingPrefix - mSurroundingSuffix;
+    const QString text(mSurroundingText.mid(mSurroundingPrefix,
+                                            mSurroundingText.size() - mSurroundingPrefix - mSurroundingSuffix));
+    sendSurroundingText(lane, mSurroundingAcknowledged, mSurroundingPrefix, length, text);
+}
+
+void DBusServerConnection::sendSurroundingText(Lane lane, uint base, int start, int length, const QString &text)
+{
+    Maliit::InputContext::AllocationScope scope(CallNames[UpdateSurroundingTextCall]);
+
+    if (++mSurroundingRevision == 0) {
+        ++mSurroundingRevision;
+    }
+    mSurroundingSynced = true;
+    mSurroundingPending = true;
+    mSurroundingWhole = length < 0;
+    mSurroundingDirty = false;
+    mSurroundingSentSize = mSurroundingText.size();
+
+    QList<QVariant> &arguments = scratchArguments(UpdateSurroundingTextCall, 7);
+    arguments[0] = base;
+    arguments[1] = mSurroundingRevision;
+    arguments[2] = start;
+    arguments[3] = length;
+    arguments[4] = text;
+    arguments[5] = mSurroundingCursor;
+    arguments[6] = mSurroundingAnchor;
+
+    // The revision counts as the server's only once it answered
+    const Maliit::InputContext::Completion answered;
+    const QPointer<DBusServerConnection> connection(this);
+    const uint revision = mSurroundingRevision;
+    answered.then([connection, revision](bool succeeded) {
+        if (connection) {
+            connection->surroundingTextAnswered(revision, succeeded);
+        }
+    });
+    sendCall(lane, UpdateSurroundingTextCall, arguments, false, -1, Completions() << answered);
+}
+
+void DBusServerConnection::surroundingTextAnswered(uint revision, bool succeeded)
+{
+    // Answers to updates a whole text replaced meanwhile do not matter
+    if (!mSurroundingPending || revision != mSurroundingRevision)
+        return;
+
+    mSurroundingPending = false;
+    if (!mPeer)
+        return;
+
+    if (succeeded) {
+        mSurroundingAcknowledged = revision;
+        flushSurroundingText(BulkLane);
+        return;
+    }
+
+    // The server's text is unknown now.  A failed whole text is not
+    // retried right away, the next update or request sends it again.
+    qWarning() << "Maliit: surrounding text update failed, sending the whole text";
+    mSurroundingSynced = false;
+    mSurroundingDirty = true;
+    if (!mSurroundingWhole) {
+        flushSurroundingText(OrderedLane);
+    }
+}
+
+void DBusServerConnection::reset(bool requireSynchronization)
+{
+    sendReset(requireSynchronization, Completions());
+}
+
+Maliit::InputContext::Completion DBusServerConnection::resetAsync(bool requireSynchronization)
+{
+    const Maliit::InputContext::Completion completion;
+    sendReset(requireSynchronization, Completions() << completion);
+    return completion;
+}
+
+void DBusServerConnection::sendReset(bool requireSynchronization, const Completions &completions)
+{
+    Maliit::InputContext::AllocationScope scope(CallNames[ResetCall]);
+    sendCall(CriticalLane, ResetCall, scratchArguments(ResetCall, 0), requireSynchronization, -1, completions);
 }
 
 void DBusServerConnection::appOrientationAboutToChange(int angle)
 {
-    if (!mProxy)
+    if (!mPeer)
         return;
 
-    mProxy->appOrientationAboutToChange(angle);
+    Maliit::InputContext::AllocationScope scope(CallNames[AppOrientationAboutToChangeCall]);
+    QList<QVariant> &arguments = scratchArguments(AppOrientationAboutToChangeCall, 1);
+    arguments[0] = angle;
+    sendCall(CriticalLane, AppOrientationAboutToChangeCall, arguments);
 }
 
 void DBusServerConnection::appOrientationChanged(int angle)
 {
-    if (!mProxy)
+    if (!mPeer)
         return;
 
-    mProxy->appOrientationChanged(angle);
+    Maliit::InputContext::AllocationScope scope(CallNames[AppOrientationChangedCall]);
+    QList<QVariant> &arguments = scratchArguments(AppOrientationChangedCall, 1);
+    arguments[0] = angle;
+    sendCall(BulkLane, AppOrientationChangedCall, arguments);
 }
 
 void DBusServerConnection::setCopyPasteState(bool copyAvailable, bool pasteAvailable)
 {
-    if (!mProxy)
+    if (!mPeer)
         return;
 
-    mProxy->setCopyPasteState(copyAvailable, pasteAvailable);
+    Maliit::InputContext::AllocationScope scope(CallNames[SetCopyPasteStateCall]);
+    QList<QVariant> &arguments = scratchArguments(SetCopyPasteStateCall, 2);
+    arguments[0] = copyAvailable;
+    arguments[1] = pasteAvailable;
+    sendCall(BulkLane, SetCopyPasteStateCall, arguments);
 }
 
 void DBusServerConnection::processKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
@@ -211,10 +1744,22 @@ void DBusServerConnection::processKeyEvent(QEvent::Type keyType, Qt::Key keyCode
                                            const QString &text, bool autoRepeat, int count,
                                            quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time)
 {
-    if (!mProxy)
+    if (!mPeer)
         return;
 
-    mProxy->processKeyEvent(keyType, keyCode, modifiers, text, autoRepeat, count, nativeScanCode, nativeModifiers, time);
+    Maliit::InputContext::AllocationScope scope(CallNames[ProcessKeyEventCall]);
+    stampInput();
+    QList<QVariant> &arguments = scratchArguments(ProcessKeyEventCall, 9);
+    arguments[0] = static_cast<int>(keyType);
+    arguments[1] = static_cast<int>(keyCode);
+    arguments[2] = static_cast<int>(modifiers);
+    arguments[3] = text;
+    arguments[4] = autoRepeat;
+    arguments[5] = count;
+    arguments[6] = nativeScanCode;
+    arguments[7] = nativeModifiers;
+    arguments[8] = static_cast<quint32>(time);
+    sendCall(CriticalLane, ProcessKeyEventCall, arguments);
 }
 
 void DBusServerConnection::keyEvent(int type, int key, int modifiers, const QString &text, bool autoRepeat,
@@ -246,3 +1791,50 @@ void DBusServerConnection::updateInputMethodArea(int x, int y, int width, int he
 {
     updateInputMethodArea(QRect(x, y, width, height));
 }
+
+void DBusServerConnection::setInputStampsEnabled(bool enabled)
+{
+    mInputStampsEnabled = enabled;
+    if (!enabled) {
+        mInputStampTimes.clear();
+    }
+}
+
+bool DBusServerConnection::inputStampsEnabled() const
+{
+    return mInputStampsEnabled;
+}
+
+qint64 DBusServerConnection::inputStampAge(quint32 id) const
+{
+    const QHash<quint32, qint64>::const_iterator it = mInputStampTimes.constFind(id);
+    if (it == mInputStampTimes.constEnd())
+        return -1;
+
+    return mInputStampClock.nsecsElapsed() - it.value();
+}
+
+void DBusServerConnection::stampInput()
+{
+    if (!mInputStampsEnabled || !mFeatures.testFlag(InputStampFeature))
+        return;
+
+    // Zero means "no stamp" to the server
+    if (++mLastInputStamp == 0)
+        ++mLastInputStamp;
+
+    // An input can cause several events, so stamps are kept until they age out
+    mInputStampTimes.remove(mLastInputStamp - MaxTrackedInputStamps);
+    mInputStampTimes.insert(mLastInputStamp, mInputStampClock.nsecsElapsed());
+
+    // Sent along with the call made next, see dispatchCall()
+    mNextInputStamp = mLastInputStamp;
+}
+
+QList<QVariant> DBusServerConnection::stampArguments(quint32 stamp) const
+{
+    // The time the input was made, not the time it could be sent
+    const qint64 stamped = mInputStampTimes.value(stamp, -1);
+    const qint64 elapsed = stamped < 0 ? mInputStampClock.elapsed() : stamped / 1000000;
+    return QList<QVariant>() << stamp << mInputStampClock.msecsSinceReference() + elapsed;
+}
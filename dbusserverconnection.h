@@ -21,19 +21,42 @@
 
 #include "mimserverconnection.h"
 
+#include "completion.h"
+#include "connectionclock.h"
 #include "inputcontextdbusaddress.h"
+#include "inputcontextdbustransport.h"
 
 #include <QDBusVariant>
 #include <QDBusPendingCallWatcher>
-
-class ComMeegoInputmethodUiserver1Interface;
+#include <QVector>
 
 class DBusServerConnection : public MImServerConnection
 {
     Q_OBJECT
 
 public:
-    explicit DBusServerConnection(const QSharedPointer<Maliit::InputContext::DBus::Address> &address);
+    //! \brief Optional protocol features, used only if the server supports them too
+    enum ProtocolFeature {
+        CompoundCallFeature = 0x1,  //!< compoundCall(a(sav)), see beginCompoundCall()
+        InputStampFeature   = 0x2,  //!< inputStamp(u,x) and eventStamp(u)
+        SurroundingTextFeature = 0x4 //!< updateSurroundingText(uuiisii) and requestSurroundingText()
+    };
+    Q_DECLARE_FLAGS(ProtocolFeatures, ProtocolFeature)
+
+    /*! \brief Connects to the server behind \a address.
+     *
+     * Connection attempts and retries, the protocol handshake and the
+     * heartbeat are timed by \a clock, by default the wall clock.  Every
+     * connection has a peer connection of its own to the server of \a seat,
+     * see SeatRouter, opened through \a transport, by default a
+     * PeerTransport.
+     */
+    explicit DBusServerConnection(const QSharedPointer<Maliit::InputContext::DBus::Address> &address,
+                                  const QSharedPointer<Maliit::InputContext::Clock> &clock
+                                      = QSharedPointer<Maliit::InputContext::Clock>(),
+                                  const QString &seat = QString(),
+                                  const QSharedPointer<Maliit::InputContext::DBus::Transport> &transport
+                                      = QSharedPointer<Maliit::InputContext::DBus::Transport>());
     ~DBusServerConnection();
 
     //! reimpl
@@ -53,6 +76,13 @@ public:
                                  Qt::KeyboardModifiers modifiers,
                                  const QString &text, bool autoRepeat, int count,
                                  quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
+    virtual void registerAttributeExtension(int id, const QString &fileName);
+    virtual void unregisterAttributeExtension(int id);
+    virtual void setExtendedAttribute(int id, const QString &target, const QString &targetItem,
+                                      const QString &attribute, const QVariant &value);
+    virtual void loadPluginSettings(const QString &descriptionLanguage);
+    virtual void beginCompoundCall();
+    virtual void endCompoundCall();
     //! reimpl end
 
     //! forwarding methods for InputContextAdaptor
@@ -66,18 +96,336 @@ public:
     using MImServerConnection::updateInputMethodArea;
     void updateInputMethodArea(int x, int y, int width, int height);
 
+    void pluginSettingsLoaded(const QList<MImPluginSettingsInfo> &info);
+    void resendSurroundingText();
+
+    /*! \brief Sends latency critical calls ahead of bulk state updates.
+     *
+     * Enabled by default.  When disabled, all calls are sent in the order they
+     * are made, as one FIFO.
+     */
+    void setPriorityLanesEnabled(bool enabled);
+    bool priorityLanesEnabled() const;
+
+    struct QueueStatistics
+    {
+        int inFlightCalls;        //!< calls sent but not answered by the server yet
+        int peakInFlightCalls;
+        int maxInFlightCalls;
+        int queuedCriticalCalls;  //!< calls held back because the cap was hit
+        int queuedBulkCalls;
+        quint64 mergedCalls;      //!< state updates superseded while queued
+        quint64 droppedCalls;     //!< queued calls given up on, on overflow or when disconnected
+        quint64 lostCalls;        //!< one-way calls a failed acknowledgement covered, not sent again
+    };
+
+    /*! \brief Limits the number of calls awaiting a reply from the server.
+     *
+     * Once \a max calls are in flight, further calls are queued.  Queued state
+     * updates are merged with newer ones, key events are kept.  The queue is
+     * bounded: once full, the oldest queued input fails to make room, and if
+     * there is none the new call fails.  Zero disables the limit.
+     */
+    void setMaxInFlightCalls(int max);
+    int maxInFlightCalls() const;
+
+    QueueStatistics queueStatistics() const;
+
+    /*! \brief Sends calls nobody waits for without asking for a reply.
+     *
+     * Enabled by default.  Resets requiring synchronization and calls made
+     * through the ...Async() methods still expect a reply.  While the number
+     * Every few one-way calls one is sent expecting a reply, whether or not
+     * the calls in flight are limited; as the server handles calls in
+     * order, it acknowledges the one-way calls before it too.  When that
+     * reply is an error, the state updates among them are sent again,
+     * expecting a reply each, unless a newer one was made meanwhile; the
+     * other calls count as lost.
+     */
+    void setOneWayCallsEnabled(bool enabled);
+    bool oneWayCallsEnabled() const;
+
+    /*! \brief Probes the server every \a interval ms.
+     *
+     * The server is declared unresponsive when a probe is not answered within
+     * \a budget ms, which defaults to \a interval if not positive.  An
+     * \a interval of zero, the default, disables probing.
+     */
+    void setHeartbeat(int interval, int budget);
+    //! \brief Round trip time of the last answered probe in ms, -1 if unknown
+    int serverResponseTime() const;
+    bool isServerResponsive() const;
+
+    /*! \brief Stamps outgoing input events for latency measurement.
+     *
+     * Key events, preedit updates and preedit clicks carry an inputStamp
+     * call with an id and the monotonic time in ms, sent in one compoundCall
+     * with them if the server supports it.  Of queued input only the newest
+     * is stamped.  Servers supporting it echo the id ahead of the events the
+     * input caused, see eventStamp().  Disabled by default.
+     */
+    void setInputStampsEnabled(bool enabled);
+    bool inputStampsEnabled() const;
+    //! \brief Time in ns since the input stamped \a id was sent, -1 if unknown
+    qint64 inputStampAge(quint32 id) const;
+
+    /*! \brief Features agreed on with the connected server.
+     *
+     * Negotiated by a handshake on connect.  If the server behind the address
+     * answered before, connected() does not wait for the handshake to
+     * complete; only the base protocol is used until the server's reply
+     * arrives.
+     */
+    ProtocolFeatures protocolFeatures() const;
+    //! \brief Protocol version agreed on with the connected server, 0 if none
+    uint protocolVersion() const;
+
+    QString seat() const;
+
+    /*! \brief Replaces \a length characters of the surrounding text at \a start by \a text.
+     *
+     * Servers supporting SurroundingTextFeature receive only the edit, which
+     * costs the same for any length of text.  The "surroundingText" of
+     * updateWidgetInformation() is sent to them the same way, as its
+     * difference to the last known text, right after and in the same lane
+     * as the rest of the information.  Each edit applies to the revision
+     * the server last confirmed; edits made while waiting for that answer
+     * are merged into one.  When an edit fails, or a server that lost track
+     * asks for it, the whole text is sent again.  Without server support
+     * the text is only tracked locally.
+     */
+    void updateSurroundingText(int start, int length, const QString &text, int cursor, int anchor);
+
+    //! \brief Delay in ms before retrying a failed or lost connection
+    void setConnectionRetryInterval(int interval);
+    int connectionRetryInterval() const;
+    //! \brief Time in ms from the last disconnection, or from construction,
+    //! until connected() was emitted; -1 if not connected yet
+    qint64 recoveryTime() const;
+
+    //! \brief Wall time spent in each phase of the last connect, in µs
+    struct ConnectTimings
+    {
+        ConnectTimings()
+            : addressResolution(-1), peerConnection(-1), objectSetup(-1)
+            , negotiation(-1), total(-1)
+        {}
+
+        qint64 addressResolution; //!< of the last attempt, retries before it count in total only
+        qint64 peerConnection;
+        qint64 objectSetup;       //!< proxy, disconnection watch and adaptor registration
+        qint64 negotiation;       //!< until connected(), short if the server was known
+        qint64 total;             //!< from construction or disconnection until connected()
+    };
+
+    //! \brief Breakdown of the last successful connect, -1 where not measured yet
+    ConnectTimings connectTimings() const;
+
+    /*! \brief Variants returning a handle that finishes once the server answered.
+     *
+     * The handle fails if the call could not be delivered, e.g. when not
+     * connected.  A state update superseded by a newer one while queued
+     * finishes together with the newer one.
+     */
+    Maliit::InputContext::Completion activateContextAsync();
+    Maliit::InputContext::Completion updateWidgetInformationAsync(const QMap<QString, QVariant> &stateInformation,
+                                                                  bool focusChanged);
+    Maliit::InputContext::Completion resetAsync(bool requireSynchronization);
+
 private Q_SLOTS:
     void connectToDBus();
     void openDBusConnection(const QString &addressString);
     void connectToDBusFailed(const QString &errorMessage);
     void onDisconnection();
-    void resetCallFinished(QDBusPendingCallWatcher*);
+    void callFinished(QDBusPendingCallWatcher*);
+    void flushBulkLane();
+    void sendHeartbeat();
+    void heartbeatFinished(QDBusPendingCallWatcher*);
+    void heartbeatExpired();
+    void serverIntrospected(QDBusPendingCallWatcher*);
+    void protocolNegotiated(QDBusPendingCallWatcher*);
+    void protocolNegotiationExpired();
+    void flushExtendedAttributes();
+    void deliverPluginSettings();
 
 private:
+    enum Lane {
+        CriticalLane, //!< sent right away: keys, preedit, reset
+        OrderedLane,  //!< sent right away, but after everything in the bulk lane
+        BulkLane      //!< state updates, sent once pending events are processed
+    };
+
+    enum Call {
+        ActivateContextCall,
+        ShowInputMethodCall,
+        HideInputMethodCall,
+        MouseClickedOnPreeditCall,
+        SetPreeditCall,
+        UpdateWidgetInformationCall,
+        ResetCall,
+        AppOrientationAboutToChangeCall,
+        AppOrientationChangedCall,
+        SetCopyPasteStateCall,
+        ProcessKeyEventCall,
+        RegisterAttributeExtensionCall,
+        UnregisterAttributeExtensionCall,
+        SetExtendedAttributeCall,
+        LoadPluginSettingsCall,
+        InputStampCall,
+        UpdateSurroundingTextCall,
+        CompoundCall,
+        CallCount
+    };
+
+    struct OutgoingCall
+    {
+        OutgoingCall(Lane lane, Call call, const QList<QVariant> &arguments,
+                     bool synchronized = false, int payloadSize = 0)
+            : lane(lane), call(call), arguments(arguments), synchronized(synchronized)
+            , payloadSize(payloadSize), stamp(0), sequence(0)
+        {}
+
+        Lane lane;         //!< lane the call was made on
+        Call call;
+        QList<QVariant> arguments;
+        bool synchronized; //!< tracked by pendingResets() until answered
+        int payloadSize;   //!< estimated, for the connection counters
+        quint32 stamp;     //!< input stamp sent along, 0 if none
+        quint32 sequence;  //!< calls of the same kind made so far, see mMadeCalls
+        QList<Maliit::InputContext::Completion> completions; //!< finished once answered
+    };
+
+    typedef QList<Maliit::InputContext::Completion> Completions;
+
+    QList<QVariant> &scratchArguments(Call call, int count);
+    void sendCall(Lane lane, Call call, const QList<QVariant> &arguments,
+                  bool synchronized = false, int payloadSize = -1,
+                  const Completions &completions = Completions());
+    void sendActivateContext(const Completions &completions);
+    void sendWidgetInformation(const QMap<QString, QVariant> &stateInformation, bool focusChanged,
+                               const Completions &completions);
+    void sendReset(bool requireSynchronization, const Completions &completions);
+    void queueCriticalCall(const OutgoingCall &call);
+    void queueBulkCall(const OutgoingCall &call);
+    //! \brief Whether a newer call of this kind makes a queued one stale
+    static bool supersedes(Call call);
+    //! \brief Whether a queued call may be failed to keep the queue bounded
+    static bool droppable(Call call);
+    //! \brief Whether the call carries complete state, so that sending it again is harmless
+    static bool resendable(Call call);
+    void acknowledgementFailed(const QList<OutgoingCall> &calls, const QDBusError &error);
+    void drainQueues(bool includeBulk);
+    void dispatchCall(const OutgoingCall &call);
+    bool saturated() const;
+    void clearQueues();
+    void countQueuedResets(int delta);
+    Completions takeQueuedCompletions();
+    //! \brief Fails all calls awaiting the server, in flight or queued
+    void abandonCalls();
+    void traceAddressResolution();
+    void startHeartbeat();
+    void stopHeartbeat();
+    bool negotiateProtocol();
+    void setProtocol(uint version, ProtocolFeatures features, const QString &serverVersion);
+    void finishConnecting();
+    qint64 phaseTime();
+    void introspectServer();
+    void registerAttributeExtensions();
+    void requestPluginSettings();
+    void stampInput();
+    QList<QVariant> stampArguments(quint32 stamp) const;
+    void syncSurroundingText(const QString &text, int cursor, int anchor, bool full);
+    void noteSurroundingEdit(int start, int length, int size);
+    void flushSurroundingText(Lane lane);
+    void sendSurroundingText(Lane lane, uint base, int start, int length, const QString &text);
+    void surroundingTextAnswered(uint revision, bool succeeded);
+
     QSharedPointer<Maliit::InputContext::DBus::Address> mAddress;
-    ComMeegoInputmethodUiserver1Interface *mProxy;
+    QSharedPointer<Maliit::InputContext::Clock> mClock;
+    QSharedPointer<Maliit::InputContext::DBus::Transport> mTransport;
+    QString mSeat;
+    QString mConnectionName; //!< of its own peer connection
+    int mRetryInterval;
+    qint64 mDisconnectedAt; //!< in ms of mClock, -1 while connected
+    qint64 mRecoveryTime;
+    QString mSurroundingText; //!< latest known, sent or not
+    int mSurroundingCursor;
+    int mSurroundingAnchor;
+    uint mSurroundingRevision; //!< of the last update sent
+    uint mSurroundingAcknowledged; //!< last revision the server confirmed, edits apply to it
+    bool mSurroundingSynced; //!< whether edits will do, otherwise the whole text is sent
+    bool mSurroundingPending; //!< the last update awaits its answer, edits wait for it
+    bool mSurroundingWhole; //!< the last update sent is the whole text
+    bool mSurroundingDirty; //!< changed since the last update sent
+    int mSurroundingPrefix; //!< characters unchanged since then at the start,
+    int mSurroundingSuffix; //!< and at the end
+    int mSurroundingSentSize; //!< length of the text as of the last update sent
+    QElapsedTimer mConnectClock; //!< since construction or the last disconnection
+    qint64 mPhaseStart; //!< in ns of mConnectClock
+    ConnectTimings mConnectTimings; //!< of the ongoing connect
+    ConnectTimings mLastConnectTimings;
+    qint64 mAddressRequested; //!< trace timestamp, -1 unless tracing
+    Maliit::InputContext::DBus::Peer *mPeer; //!< while connected
     bool mActive;
     QSet<QDBusPendingCallWatcher*> pendingResetCalls;
+    bool mPriorityLanes;
+    QList<OutgoingCall> mCriticalLane;
+    QList<OutgoingCall> mBulkLane;
+    QTimer mBulkFlushTimer;
+    QHash<QDBusPendingCallWatcher*, int> mInFlightCalls; //!< calls each reply acknowledges
+    int mInFlightCount;
+    bool mOneWayCalls;
+    QList<OutgoingCall> mUnacknowledgedCalls; //!< one-way calls sent since the last call expecting a reply
+    QHash<QDBusPendingCallWatcher*, QList<OutgoingCall> > mAcknowledgedCalls; //!< one-way calls each reply covers
+    QVector<quint32> mMadeCalls; //!< calls made so far, per kind
+    QHash<QDBusPendingCallWatcher*, Completions> mCompletions;
+    int mMaxInFlightCalls;
+    int mQueuedSynchronizedCalls; //!< in the lanes or in the open compound call
+    QueueStatistics mStatistics;
+    QList<QVariant> mScratchArguments[CallCount];
+    int mHeartbeatInterval; //!< in ms of mClock, like everything below
+    int mHeartbeatBudget;
+    qint64 mHeartbeatSentAt;
+    QDBusPendingCallWatcher *mHeartbeat;
+    int mServerResponseTime;
+    bool mServerResponsive;
+    QString mServerAddress;
+    QDBusPendingCallWatcher *mHandshake;
+    bool mConnecting; //!< connected() is held back until the handshake completes
+    uint mProtocolVersion;
+    ProtocolFeatures mFeatures;
+    QDBusPendingCallWatcher *mIntrospection;
+    int mCompoundDepth;
+    QList<OutgoingCall> mCompound;
+
+    struct ExtendedAttribute
+    {
+        int id;
+        QString target;
+        QString targetItem;
+        QString attribute;
+        QVariant value;
+    };
+
+    QHash<int, QString> mAttributeExtensions;
+    QSet<int> mRegisteredExtensions; //!< extensions the server knows about
+    QHash<QString, ExtendedAttribute> mExtendedAttributes; //!< latest value of each attribute
+    QStringList mPendingAttributes; //!< attributes to send on the next flush
+    QTimer mAttributeFlushTimer;
+
+    QString mServerVersion;
+    QString mPluginSettingsLanguage;
+    QList<MImPluginSettingsInfo> mPluginSettings;
+    bool mPluginSettingsRequested; //!< awaiting the server's complete list
+    bool mPluginSettingsDelivered;
+
+    bool mInputStampsEnabled;
+    quint32 mLastInputStamp;
+    quint32 mNextInputStamp; //!< taken along by the next call made, 0 if none
+    QElapsedTimer mInputStampClock;
+    QHash<quint32, qint64> mInputStampTimes; //!< send time of recent stamps in ns
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(DBusServerConnection::ProtocolFeatures)
+
 #endif // DBUSSERVERCONNECTION_H
@@ -76,6 +76,16 @@ void FixedAddress::get()
     Q_EMIT this->addressReceived(mAddress);
 }
 
+UnavailableAddress::UnavailableAddress(const QString &reason)
+    : mReason(reason)
+{
+}
+
+void UnavailableAddress::get()
+{
+    Q_EMIT addressFetchError(mReason);
+}
+
 } // namespace DBus
 } // namespace InputContext
 } // namespace Maliit
@@ -64,6 +64,19 @@ private:
     QString mAddress;
 };
 
+//! \brief Address that cannot be resolved, e.g. of a seat without a server
+class UnavailableAddress : public Address
+{
+    Q_OBJECT
+
+public:
+    UnavailableAddress(const QString &reason);
+    void get();
+
+private:
+    QString mReason;
+};
+
 } // namespace DBus
 } // namespace InputContext
 } // namespace Maliit
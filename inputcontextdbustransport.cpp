@@ -0,0 +1,91 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "inputcontextdbustransport.h"
+
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+
+namespace {
+    const char * const DBusLocalPath("/org/freedesktop/DBus/Local");
+    const char * const DBusLocalInterface("org.freedesktop.DBus.Local");
+    const char * const DisconnectedSignal("Disconnected");
+}
+
+namespace Maliit {
+namespace InputContext {
+namespace DBus {
+
+Peer::~Peer()
+{
+}
+
+Transport::~Transport()
+{
+}
+
+Peer *PeerTransport::connectToPeer(const QString &address, const QString &name)
+{
+    QDBusConnection connection = QDBusConnection::connectToPeer(address, name);
+    if (!connection.isConnected()) {
+        // The failed connection keeps the name otherwise, and is handed out
+        // again on the next attempt
+        QDBusConnection::disconnectFromPeer(name);
+        return 0;
+    }
+
+    return new PeerConnection(connection);
+}
+
+PeerConnection::PeerConnection(const QDBusConnection &connection)
+    : mConnection(connection)
+    , mOpen(true)
+{
+    mConnection.connect(QString(), QString::fromLatin1(DBusLocalPath), QString::fromLatin1(DBusLocalInterface),
+                        QString::fromLatin1(DisconnectedSignal), this, SLOT(onDisconnection()));
+}
+
+PeerConnection::~PeerConnection()
+{
+    if (mOpen) {
+        QDBusConnection::disconnectFromPeer(mConnection.name());
+    }
+}
+
+bool PeerConnection::registerObject(const QString &path, QObject *object)
+{
+    return mConnection.registerObject(path, object);
+}
+
+void PeerConnection::send(const QDBusMessage &message)
+{
+    mConnection.send(message);
+}
+
+QDBusPendingCallWatcher *PeerConnection::call(const QDBusMessage &message, QObject *parent)
+{
+    return new QDBusPendingCallWatcher(mConnection.asyncCall(message), parent);
+}
+
+void PeerConnection::onDisconnection()
+{
+    // Released right away, a reconnect may reuse the name before this
+    // object is gone
+    mOpen = false;
+    QDBusConnection::disconnectFromPeer(mConnection.name());
+    Q_EMIT disconnected();
+}
+
+} // namespace DBus
+} // namespace InputContext
+} // namespace Maliit
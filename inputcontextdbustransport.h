@@ -0,0 +1,100 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_DBUS_INPUTCONTEXTDBUSTRANSPORT_H
+#define MALIIT_INPUTCONTEXT_DBUS_INPUTCONTEXTDBUSTRANSPORT_H
+
+#include <QDBusConnection>
+#include <QObject>
+
+class QDBusMessage;
+class QDBusPendingCallWatcher;
+
+namespace Maliit {
+namespace InputContext {
+namespace DBus {
+
+/*! \brief Open connection to an input method server, see Transport.
+ *
+ * Deleting it closes the connection.
+ */
+class Peer : public QObject
+{
+    Q_OBJECT
+
+public:
+    virtual ~Peer();
+
+    //! \brief Lets the server call the slots of \a object at \a path
+    virtual bool registerObject(const QString &path, QObject *object) = 0;
+    //! \brief Sends \a message without asking for a reply
+    virtual void send(const QDBusMessage &message) = 0;
+    //! \brief Sends \a message, the returned watcher is a child of \a parent
+    virtual QDBusPendingCallWatcher *call(const QDBusMessage &message, QObject *parent) = 0;
+
+Q_SIGNALS:
+    //! \brief The server closed the connection; no more calls are answered
+    void disconnected();
+};
+
+/*! \brief Opens the connections of DBusServerConnection.
+ *
+ * PeerTransport is used unless another one is given, e.g. one that needs
+ * no socket in tests.
+ */
+class Transport
+{
+public:
+    virtual ~Transport();
+
+    //! \brief Connects to the server at \a address as \a name, 0 on failure
+    virtual Peer *connectToPeer(const QString &address, const QString &name) = 0;
+};
+
+//! \brief Peer-to-peer D-Bus connections
+class PeerTransport : public Transport
+{
+public:
+    //! reimpl
+    virtual Peer *connectToPeer(const QString &address, const QString &name);
+    //! reimpl end
+};
+
+//! \brief Peer opened by PeerTransport
+class PeerConnection : public Peer
+{
+    Q_OBJECT
+
+public:
+    explicit PeerConnection(const QDBusConnection &connection);
+    virtual ~PeerConnection();
+
+    //! reimpl
+    virtual bool registerObject(const QString &path, QObject *object);
+    virtual void send(const QDBusMessage &message);
+    virtual QDBusPendingCallWatcher *call(const QDBusMessage &message, QObject *parent);
+    //! reimpl end
+
+private Q_SLOTS:
+    void onDisconnection();
+
+private:
+    QDBusConnection mConnection;
+    bool mOpen; //!< the name is still ours to release
+};
+
+} // namespace DBus
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_DBUS_INPUTCONTEXTDBUSTRANSPORT_H
@@ -62,6 +62,16 @@ bool MImServerConnection::pendingResets()
     return false;
 }
 
+Maliit::InputContext::ConnectionCounters &MImServerConnection::counters()
+{
+    return mCounters;
+}
+
+const Maliit::InputContext::ConnectionCounters &MImServerConnection::counters() const
+{
+    return mCounters;
+}
+
 void MImServerConnection::appOrientationAboutToChange(int angle)
 {
     Q_UNUSED(angle);
@@ -120,3 +130,9 @@ void MImServerConnection::loadPluginSettings(const QString &descriptionLanguage)
 {
     Q_UNUSED(descriptionLanguage);
 }
+
+void MImServerConnection::beginCompoundCall()
+{}
+
+void MImServerConnection::endCompoundCall()
+{}
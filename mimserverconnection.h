@@ -19,12 +19,13 @@
 #ifndef MIMSERVERCONNECTION_H
 #define MIMSERVERCONNECTION_H
 
+#include "connectioncounters.h"
 #include "namespace.h"
+#include "settingdata.h"
 
 #include <QtCore>
 
 class MImServerConnectionPrivate;
-class MImPluginSettingsInfo;
 
 class MImServerConnection : public QObject
 {
@@ -36,6 +37,14 @@ public:
 
     virtual bool pendingResets();
 
+    /*! \brief Traffic and health counters of this connection.
+     *
+     * Safe to read from any thread, see ConnectionCounters::snapshot() and
+     * ConnectionCounters::report().
+     */
+    Maliit::InputContext::ConnectionCounters &counters();
+    const Maliit::InputContext::ConnectionCounters &counters() const;
+
     /* Outgoing communication */
     virtual void activateContext();
     virtual void showInputMethod();
@@ -57,6 +66,16 @@ public:
                                       const QString &attribute, const QVariant &value);
     virtual void loadPluginSettings(const QString &descriptionLanguage);
 
+    /*! \brief Groups the outgoing calls made until \a endCompoundCall().
+     *
+     * Servers that support it receive the calls as a single message and apply
+     * them atomically, others receive them one by one as usual.  Calls nest.
+     * State updates are only taken into the message by a later activation,
+     * show or focus change; otherwise they are merged and sent as usual.
+     */
+    virtual void beginCompoundCall();
+    virtual void endCompoundCall();
+
 public:
     /*! \brief Notifies about connection to server being established.
      *
@@ -66,6 +85,14 @@ public:
     Q_SIGNAL void connected();
     Q_SIGNAL void disconnected();
 
+    /*! \brief Notifies that the server stopped answering within the liveness budget.
+     *
+     * The connection is still open, but input sent now is unlikely to be handled
+     * in time.  Followed by \a serverResponsive() once the server answers again.
+     */
+    Q_SIGNAL void serverUnresponsive();
+    Q_SIGNAL void serverResponsive();
+
     /* Incoming communication */
     Q_SIGNAL void activationLostEvent();
 
@@ -141,6 +168,15 @@ public:
      */
     Q_SIGNAL void setRedirectKeys(bool enabled);
 
+    /*!
+     * \brief Set which hardware keys the input method wants redirected.
+     *
+     * Keys matching none of the \a rules are of no interest to the input
+     * method and are handled by the application.  An empty list redirects
+     * every key.  Only applies while \a setRedirectKeys is enabled.
+     */
+    Q_SIGNAL void setRedirectKeyFilter(const QList<Maliit::KeyRedirectRule> &rules);
+
     /*!
      * \brief Set detectable autorepeat for X on/off
      *
@@ -197,8 +233,18 @@ public:
      */
     Q_SIGNAL void pluginSettingsReceived(const QList<MImPluginSettingsInfo> &info);
 
+    /*!
+     * \brief Tells that the following events were caused by the input stamped \a id.
+     *
+     * Sent by servers that support latency stamps, ahead of the commitString,
+     * updatePreedit or keyEvent calls resulting from that input.
+     */
+    Q_SIGNAL void eventStamp(quint32 id);
+
 private:
     Q_DISABLE_COPY(MImServerConnection)
+
+    Maliit::InputContext::ConnectionCounters mCounters;
 };
 
 #endif
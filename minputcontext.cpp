@@ -20,23 +20,98 @@
  */
 
 #include "minputcontext.h"
+#include "seatrouter.h"
+#include "tracepoints.h"
+#include "tracing.h"
 #include <QDebug>
 
+namespace
+{
+    const int OrientationSettleInterval(250); // in ms
+    const int NoAngle(-1);
+
+    bool isOfflineEditingKey(Qt::Key key)
+    {
+        switch (key) {
+        case Qt::Key_Backspace:
+        case Qt::Key_Delete:
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+        case Qt::Key_Tab:
+        case Qt::Key_Left:
+        case Qt::Key_Right:
+        case Qt::Key_Up:
+        case Qt::Key_Down:
+        case Qt::Key_Home:
+        case Qt::Key_End:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool isOfflineText(Qt::KeyboardModifiers modifiers, const QString &text)
+    {
+        if (text.isEmpty() || (modifiers & (Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier))) {
+            return false;
+        }
+        Q_FOREACH (const QChar &character, text) {
+            if (!character.isPrint()) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
 bool MInputContext::debug = false;
 
-MInputContext::MInputContext()
+MInputContext::MInputContext(const QString &seat)
     : imServer(NULL),
       active(false),
       inputPanelState(InputPanelHidden),
       mIMServerRestart(false),
-      mAngle(Angle0)
+      mAngle(Angle0),
+      mServerAngle(NoAngle),
+      mAnnouncedAngle(NoAngle),
+      mOrientationLayoutPending(false),
+      mOrientationLatency(-1),
+      mRedirectKeys(false),
+      mDetectableAutoRepeat(false),
+      mContentType(Maliit::FreeTextContentType),
+      mRepeatKey(0),
+      mRepeatCount(0),
+      mRepeatReleased(false),
+      mRepeatPaired(true),
+      mEventStamp(0),
+      mInputLatency(-1),
+      mTrafficGating(true),
+      mLocalEcho(false),
+      mServerAvailable(false),
+      mOfflineFallback(false),
+      mStateInfoPending(false),
+      mPendingFocusChange(false),
+      mCopyAvailable(false),
+      mPasteAvailable(false),
+      mCopyPastePending(false)
 {
-    if (debug) qDebug() << "MInputContext()";
+    if (debug) qDebug() << "MInputContext(), seat = " << seat;
 
     qRegisterMetaType<MInputContext::OrientationAngle >();
 
-    QSharedPointer<Maliit::InputContext::DBus::Address> address(new Maliit::InputContext::DBus::DynamicAddress);
-    imServer = new DBusServerConnection(address);
+    // Sensors report a burst of angles while the device is being rotated,
+    // only the angle it settles on is committed to the server.
+    orientationTimer.setSingleShot(true);
+    orientationTimer.setInterval(OrientationSettleInterval);
+    connect(&orientationTimer, SIGNAL(timeout()), this, SLOT(commitServerOrientation()));
+
+    // Autorepeat events arriving in the same batch are merged until the
+    // event loop gets back to this timer.
+    keyRepeatTimer.setSingleShot(true);
+    keyRepeatTimer.setInterval(0);
+    connect(&keyRepeatTimer, SIGNAL(timeout()), this, SLOT(flushKeyRepeat()));
+
+    imServer = Maliit::InputContext::SeatRouter::instance()->createConnection(seat);
     connectInputMethodServer();
 }
 
@@ -51,6 +126,8 @@ void MInputContext::connectInputMethodServer()
 
     connect(imServer, SIGNAL(connected()), this, SLOT(onDBusConnection()));
     connect(imServer, SIGNAL(disconnected()), this, SLOT(onDBusDisconnection()));
+    connect(imServer, SIGNAL(serverUnresponsive()), this, SLOT(onServerUnresponsive()));
+    connect(imServer, SIGNAL(serverResponsive()), this, SLOT(onServerResponsive()));
 
     // Hook up incoming communication from input method server
     connect(imServer, SIGNAL(activationLostEvent()), this, SLOT(activationLostEvent()));
@@ -76,6 +153,9 @@ void MInputContext::connectInputMethodServer()
 
     connect(imServer, SIGNAL(setRedirectKeys(bool)), this, SLOT(setRedirectKeys(bool)));
 
+    connect(imServer, SIGNAL(setRedirectKeyFilter(QList<Maliit::KeyRedirectRule>)),
+            this, SLOT(setRedirectKeyFilter(QList<Maliit::KeyRedirectRule>)));
+
     connect(imServer, SIGNAL(setDetectableAutoRepeat(bool)),
             this, SLOT(setDetectableAutoRepeat(bool)));
 
@@ -87,18 +167,28 @@ void MInputContext::connectInputMethodServer()
 
     connect(imServer, SIGNAL(setLanguage(QString)),
             this, SLOT(setLanguage(QString)));
+
+    connect(imServer, SIGNAL(extendedAttributeChanged(int,QString,QString,QString,QVariant)),
+            this, SLOT(extendedAttributeChanged(int,QString,QString,QString,QVariant)));
+
+    connect(imServer, SIGNAL(pluginSettingsReceived(QList<MImPluginSettingsInfo>)),
+            this, SLOT(pluginSettingsReceived(QList<MImPluginSettingsInfo>)));
+
+    connect(imServer, SIGNAL(eventStamp(quint32)), this, SLOT(eventStamp(quint32)));
 }
 
 void MInputContext::setLanguage(const QString &language)
 {
     if (debug) qDebug() << "unimplemented setLanuage()";
+    flushKeyRepeat();
 }
 
 void MInputContext::reset()
 {
     if (debug) qDebug() << "reset()";
 
-    const bool hadPreedit = !preedit.isEmpty();
+    const bool hadPreedit = !preedit.isEmpty() || !mEchoText.isEmpty();
+    mEchoText.clear();
 
     // reset input method server, preedit requires synchronization.
     // rationale: input method might be autocommitting existing preedit without
@@ -106,44 +196,223 @@ void MInputContext::reset()
     imServer->reset(hadPreedit);
 }
 
+Maliit::InputContext::Completion MInputContext::resetAsync()
+{
+    if (debug) qDebug() << "resetAsync()";
+
+    const bool hadPreedit = !preedit.isEmpty() || !mEchoText.isEmpty();
+    mEchoText.clear();
+    return imServer->resetAsync(hadPreedit);
+}
+
 void MInputContext::updateStateInfo(QMap<QString, QVariant> stateInfo, bool focusChanged)
 {
+    sendStateInfo(stateInfo, focusChanged, false);
+}
+
+Maliit::InputContext::Completion MInputContext::updateStateInfoAsync(const QMap<QString, QVariant> &stateInfo,
+                                                                     bool focusChanged)
+{
+    return sendStateInfo(stateInfo, focusChanged, true);
+}
+
+Maliit::InputContext::Completion MInputContext::sendStateInfo(const QMap<QString, QVariant> &stateInfo,
+                                                              bool focusChanged, bool track)
+{
+    mContentType = stateInfo.value(QLatin1String("contentType"),
+                                   static_cast<int>(Maliit::FreeTextContentType)).toInt();
+
+    // Only the latest state matters once the context gets activated
+    focusChanged = focusChanged || mPendingFocusChange;
+    if (trafficHeld() && !track) {
+        mPendingStateInfo = stateInfo;
+        mStateInfoPending = true;
+        mPendingFocusChange = focusChanged;
+        return Maliit::InputContext::Completion::finished(true);
+    }
+    mPendingStateInfo.clear();
+    mStateInfoPending = false;
+    mPendingFocusChange = false;
+
     // Clear preedit String on im server side to avoid showing up
     // on new edit box
+    imServer->beginCompoundCall();
     if (focusChanged) {
         reset();
     }
 
-    imServer->updateWidgetInformation(stateInfo, focusChanged);
+    Maliit::InputContext::Completion completion(Maliit::InputContext::Completion::finished(true));
+    if (track) {
+        completion = imServer->updateWidgetInformationAsync(stateInfo, focusChanged);
+    } else {
+        imServer->updateWidgetInformation(stateInfo, focusChanged);
+    }
+    imServer->endCompoundCall();
+    return completion;
+}
+
+void MInputContext::updateCopyPasteState(bool copyAvailable, bool pasteAvailable)
+{
+    if (debug) qDebug() << "updateCopyPasteState(), copy = " << copyAvailable << ", paste = " << pasteAvailable;
+
+    mCopyAvailable = copyAvailable;
+    mPasteAvailable = pasteAvailable;
+    if (trafficHeld()) {
+        mCopyPastePending = true;
+        return;
+    }
+
+    mCopyPastePending = false;
+    imServer->setCopyPasteState(copyAvailable, pasteAvailable);
+}
+
+void MInputContext::updateSurroundingText(int start, int length, const QString &text, int cursor, int anchor)
+{
+    if (debug) qDebug() << "updateSurroundingText(), start = " << start << ", length = " << length;
+
+    imServer->updateSurroundingText(start, length, text, cursor, anchor);
+}
+
+void MInputContext::setTrafficGatingEnabled(bool enabled)
+{
+    if (debug) qDebug() << "setTrafficGatingEnabled(), enabled = " << enabled;
+
+    mTrafficGating = enabled;
+    if (!enabled) {
+        imServer->beginCompoundCall();
+        sendPendingState();
+        imServer->endCompoundCall();
+    }
+}
+
+bool MInputContext::trafficHeld() const
+{
+    // A hidden panel does not need the state of the widget it is not shown for
+    return mTrafficGating && (!active || inputPanelState == InputPanelHidden);
+}
+
+void MInputContext::sendPendingState()
+{
+    if (mStateInfoPending) {
+        const QMap<QString, QVariant> stateInfo(mPendingStateInfo);
+        const bool focusChanged = mPendingFocusChange;
+        mPendingStateInfo.clear();
+        mStateInfoPending = false;
+        mPendingFocusChange = false;
+
+        if (focusChanged) {
+            reset();
+        }
+        imServer->updateWidgetInformation(stateInfo, focusChanged);
+    }
+
+    if (mCopyPastePending) {
+        mCopyPastePending = false;
+        imServer->setCopyPasteState(mCopyAvailable, mPasteAvailable);
+    }
 }
 
 void MInputContext::onInvokeAction(const QString &action, const QKeySequence &sequence)
 {
     if (debug) qDebug() << "unimplemented onInvokeAction()";
+    flushKeyRepeat();
 }
 
 void MInputContext::updateServerOrientation(MInputContext::OrientationAngle angle)
 {
     if (debug) qDebug() << "updateServerOrientation(): angle = " << angle;
 
-    if (active) {
-        imServer->appOrientationChanged(static_cast<int>(angle));
-    }
     mAngle = angle;
+
+    // Inactive contexts send their angle on activation
+    if (!active) {
+        return;
+    }
+
+    if (!orientationTimer.isActive()) {
+        if (angle == mServerAngle) {
+            return;
+        }
+        orientationClock.start();
+    }
+
+    // Let the server start preparing the rotated layout right away
+    if (angle != mAnnouncedAngle && angle != mServerAngle) {
+        imServer->appOrientationAboutToChange(static_cast<int>(angle));
+        mAnnouncedAngle = angle;
+    }
+
+    orientationTimer.start();
+}
+
+void MInputContext::commitServerOrientation()
+{
+    if (debug) qDebug() << "commitServerOrientation(): angle = " << mAngle;
+
+    if (!active) {
+        return;
+    }
+
+    // Also commit when the rotation ended up at the old angle, so that the
+    // server drops the layout it prepared for the announced one.
+    if (mAngle != mServerAngle || mAnnouncedAngle != NoAngle) {
+        imServer->appOrientationChanged(static_cast<int>(mAngle));
+        mServerAngle = mAngle;
+        mOrientationLayoutPending = true;
+    }
+    mAnnouncedAngle = NoAngle;
+}
+
+void MInputContext::cancelOrientationChange()
+{
+    orientationTimer.stop();
+    mServerAngle = NoAngle;
+    mAnnouncedAngle = NoAngle;
+    mOrientationLayoutPending = false;
+}
+
+qint64 MInputContext::orientationChangeLatency() const
+{
+    return mOrientationLatency;
 }
 
 void MInputContext::showInputPanel()
+{
+    activateAndShow(false);
+}
+
+Maliit::InputContext::Completion MInputContext::showInputPanelAsync()
+{
+    return activateAndShow(true);
+}
+
+Maliit::InputContext::Completion MInputContext::activateAndShow(bool trackActivation)
 {
     if (debug) qDebug() << "showInputPanel() active = " << active;
 
+    Maliit::InputContext::Completion activation(Maliit::InputContext::Completion::finished(true));
+
+    // Activation, orientation and showing reach the server as one message,
+    // so the panel comes up with the right layout without extra round trips.
+    // State held back while inactive or hidden catches up ahead of them.
+    imServer->beginCompoundCall();
+    sendPendingState();
     if (!active) {
-        imServer->activateContext();
+        if (trackActivation) {
+            activation = imServer->activateContextAsync();
+        } else {
+            imServer->activateContext();
+        }
         active = true;
+        cancelOrientationChange();
         imServer->appOrientationChanged(mAngle);
+        mServerAngle = mAngle;
     }
 
     imServer->showInputMethod();
+    imServer->endCompoundCall();
     inputPanelState = InputPanelShown;
+    return activation;
 }
 
 void MInputContext::hideInputPanel()
@@ -159,14 +428,18 @@ void MInputContext::activationLostEvent()
     // This method is called when activation was gracefully lost.
     // There is similar cleaning up done in onDBusDisconnection.
     if (debug) qDebug() << "activationLostEvent()";
+    flushKeyRepeat();
     active = false;
     inputPanelState = InputPanelHidden;
+    cancelOrientationChange();
 }
 
 void MInputContext::imInitiatedHide()
 {
     if (debug) qDebug() << "imInitiatedHide()";
+    flushKeyRepeat();
 
+    Maliit::InputContext::TraceSpan span("onHideInputMethod", "embedder");
     onHideInputMethod();
 }
 
@@ -180,13 +453,34 @@ void MInputContext::commitString(const QString &string, int replacementStart,
                  << ", cursorPos:" << cursorPos;
     }
 
+    flushKeyRepeat();
+
     if (imServer->pendingResets()) {
+        imServer->counters().add(Maliit::InputContext::ConnectionCounters::DroppedCommits);
+        MALIIT_TRACEPOINT3(pending_resets_drop, "commitString",
+                           Maliit::InputContext::ConnectionCounters::payloadSize(string) + 12,
+                           MALIIT_TRACEPOINT_NOW());
+        mEventStamp = 0;
         return;
     }
 
+    // Echoed text the commit does not cover stays in the preedit
+    if (!mEchoText.isEmpty()) {
+        const QString shown(preedit + mEchoText);
+        mEchoText = (replacementLength == 0 && shown.startsWith(string)) ? shown.mid(string.size())
+                                                                        : QString();
+    }
     preedit.clear();
 
-    onCommitString(string, replacementStart, replacementLength, cursorPos);
+    {
+        Maliit::InputContext::TraceSpan span("onCommitString", "embedder");
+        onCommitString(string, replacementStart, replacementLength, cursorPos);
+    }
+    if (!mEchoText.isEmpty()) {
+        Maliit::InputContext::TraceSpan span("onUpdatePreedit", "embedder");
+        onUpdatePreedit(mEchoText, 0, 0, -1);
+    }
+    reportInputLatency();
 }
 
 void MInputContext::updatePreedit(const QString &string, const QList<Maliit::PreeditTextFormat> &preeditFormats,
@@ -199,13 +493,36 @@ void MInputContext::updatePreedit(const QString &string, const QList<Maliit::Pre
                  << ", cursorPos:" << cursorPos;
     }
 
+    flushKeyRepeat();
+
     if (imServer->pendingResets()) {
+        imServer->counters().add(Maliit::InputContext::ConnectionCounters::DroppedPreedits);
+        MALIIT_TRACEPOINT3(pending_resets_drop, "updatePreedit",
+                           Maliit::InputContext::ConnectionCounters::payloadSize(string) + 12,
+                           MALIIT_TRACEPOINT_NOW());
+        mEventStamp = 0;
         return;
     }
 
+    // The server result wins, unless it is still catching up with the echo
+    bool unchanged = false;
+    if (!mEchoText.isEmpty()) {
+        const QString shown(preedit + mEchoText);
+        if (string.startsWith(preedit) && shown.startsWith(string)) {
+            mEchoText = shown.mid(string.size());
+            unchanged = replacementLength == 0 && (cursorPos < 0 || cursorPos == string.size() || !mEchoText.isEmpty());
+        } else {
+            mEchoText.clear();
+        }
+    }
     preedit = string;
 
-    onUpdatePreedit(string, replacementStart, replacementLength, cursorPos);
+    if (!unchanged) {
+        Maliit::InputContext::TraceSpan span("onUpdatePreedit", "embedder");
+        onUpdatePreedit(string + mEchoText, replacementStart, replacementLength,
+                        mEchoText.isEmpty() ? cursorPos : -1);
+    }
+    reportInputLatency();
 }
 
 void MInputContext::keyEvent(int type, int key, int modifiers, const QString &text,
@@ -214,44 +531,235 @@ void MInputContext::keyEvent(int type, int key, int modifiers, const QString &te
 {
     if (debug) qDebug() << "keyEvent()";
 
-    bool down = (type == QEvent::KeyPress);
+    const bool down = (type == QEvent::KeyPress);
+    const Qt::KeyboardModifiers keyModifiers(modifiers);
+
+    if (autoRepeat && text.isEmpty()) {
+        // A burst of the same key either alternates presses and releases, or
+        // has presses only as with detectable autorepeat; its second press
+        // tells which.  Anything else ends it so that it can be replayed as
+        // it arrived.
+        if (mRepeatCount > 0) {
+            const bool follows = down ? mRepeatCount == 1 || mRepeatReleased == mRepeatPaired
+                                      : !mRepeatReleased;
+            if (key != mRepeatKey || keyModifiers != mRepeatModifiers || !follows) {
+                flushKeyRepeat();
+            }
+        }
+        if (down) {
+            if (mRepeatCount == 0) {
+                mRepeatPaired = true;
+            } else if (mRepeatCount == 1) {
+                mRepeatPaired = mRepeatReleased;
+            }
+            mRepeatReleased = false;
+            mRepeatKey = key;
+            mRepeatModifiers = keyModifiers;
+            ++mRepeatCount;
+            keyRepeatTimer.start();
+            return;
+        }
+        if (mRepeatCount > 0) {
+            mRepeatReleased = true;
+            return;
+        }
+    } else {
+        flushKeyRepeat();
+    }
+
+    {
+        Maliit::InputContext::TraceSpan span("onKeyEvent", "embedder");
+        onKeyEvent(key, down, 1, autoRepeat, keyModifiers);
+    }
+    reportInputLatency();
+}
+
+void MInputContext::flushKeyRepeat()
+{
+    keyRepeatTimer.stop();
+
+    if (mRepeatCount == 0) {
+        return;
+    }
+
+    const int count = mRepeatCount;
+    const bool released = mRepeatReleased;
+    mRepeatCount = 0;
+    mRepeatReleased = false;
+
+    if (debug) qDebug() << "flushKeyRepeat(), key = " << mRepeatKey << ", count = " << count;
+
+    {
+        Maliit::InputContext::TraceSpan span("onKeyEvent", "embedder");
+        onKeyEvent(mRepeatKey, true, count, true, mRepeatModifiers);
+        if (released) {
+            onKeyEvent(mRepeatKey, false, 1, true, mRepeatModifiers);
+        }
+    }
+    reportInputLatency();
+}
+
+void MInputContext::setInputLatencyTracking(bool enabled)
+{
+    if (debug) qDebug() << "setInputLatencyTracking(), enabled = " << enabled;
+
+    imServer->setInputStampsEnabled(enabled);
+}
+
+void MInputContext::eventStamp(quint32 id)
+{
+    if (debug) qDebug() << "eventStamp(), id = " << id;
+
+    // A merged burst belongs to the previous stamp
+    flushKeyRepeat();
+    mEventStamp = id;
+}
+
+void MInputContext::reportInputLatency()
+{
+    if (mEventStamp == 0) {
+        return;
+    }
+
+    const quint32 id = mEventStamp;
+    mEventStamp = 0;
+
+    const qint64 latency = imServer->inputStampAge(id);
+    if (latency < 0) {
+        return;
+    }
+
+    mInputLatency = latency;
+    Maliit::InputContext::TraceSpan span("onInputLatency", "embedder");
+    onInputLatency(id, latency);
+}
+
+qint64 MInputContext::inputLatency() const
+{
+    return mInputLatency;
+}
+
+const Maliit::InputContext::ConnectionCounters &MInputContext::counters() const
+{
+    return imServer->counters();
+}
+
+DBusServerConnection::QueueStatistics MInputContext::queueStatistics() const
+{
+    return imServer->queueStatistics();
+}
+
+DBusServerConnection::ConnectTimings MInputContext::connectTimings() const
+{
+    return imServer->connectTimings();
+}
+
+qint64 MInputContext::recoveryTime() const
+{
+    return imServer->recoveryTime();
+}
+
+void MInputContext::onInputLatency(quint32 id, qint64 latency)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(latency);
+}
+
+void MInputContext::onKeyEvent(int key, bool down, int count, bool autoRepeat,
+                               Qt::KeyboardModifiers modifiers)
+{
+    Q_UNUSED(modifiers);
+
     onKeyEvent(key, down);
+    if (autoRepeat && down) {
+        for (int i = 1; i < count; ++i) {
+            if (mRepeatPaired) {
+                onKeyEvent(key, false);
+            }
+            onKeyEvent(key, true);
+        }
+    }
+}
+
+bool MInputContext::keyRepeatPaired() const
+{
+    return mRepeatPaired;
 }
 
 void MInputContext::updateInputMethodArea(const QRect &rect)
 {
+    flushKeyRepeat();
+
     int x = rect.x();
     int y = rect.y();
     int w = rect.width();
     int h = rect.height();
 
-    onUpdateInputMethodArea(x, y, w, h);
+    {
+        Maliit::InputContext::TraceSpan span("onUpdateInputMethodArea", "embedder");
+        onUpdateInputMethodArea(x, y, w, h);
+    }
+
+    if (mOrientationLayoutPending) {
+        mOrientationLayoutPending = false;
+        mOrientationLatency = orientationClock.elapsed();
+        if (debug) qDebug() << "orientation change took" << mOrientationLatency << "ms";
+    }
 }
 
 void MInputContext::setGlobalCorrectionEnabled(bool enabled)
 {
     if (debug) qDebug() << "setGlobalCorrectionEnabled(), enabled = " << enabled;
+    flushKeyRepeat();
 
-    QMap<QString, QVariant> stateInformation = getStateInformation();
+    QMap<QString, QVariant> stateInformation = currentStateInformation();
     updateStateInfo(stateInformation, true);
 }
 
 void MInputContext::onDBusDisconnection()
 {
     if (debug) qDebug() << "onDBusDisconnection()";
+    flushKeyRepeat();
+    mEventStamp = 0;
+    mServerAvailable = false;
+
+    // Keep what was typed so far, the restarted server starts afresh
+    if (mOfflineFallback && (!preedit.isEmpty() || !mEchoText.isEmpty())) {
+        Maliit::InputContext::TraceSpan span("onCommitString", "embedder");
+        onCommitString(preedit + mEchoText, 0, 0, -1);
+    }
+    preedit.clear();
+    mEchoText.clear();
     active = false;
     mIMServerRestart = true;
+    cancelOrientationChange();
+
+    // A restarted server asks for key redirection again if it needs it
+    mRedirectKeys = false;
+    mDetectableAutoRepeat = false;
+    mRedirectRules.clear();
+    mRedirectedKeys.clear();
 
     updateInputMethodArea(QRect());
 }
 
+QMap<QString, QVariant> MInputContext::currentStateInformation()
+{
+    Maliit::InputContext::TraceSpan span("getStateInformation", "embedder");
+    return getStateInformation();
+}
+
 void MInputContext::onDBusConnection()
 {
     if (debug) qDebug() << "onDBusConnection()";
     active = false;
-    onConnectionReady();
+    mServerAvailable = true;
+    {
+        Maliit::InputContext::TraceSpan span("onConnectionReady", "embedder");
+        onConnectionReady();
+    }
     if (mIMServerRestart && inputPanelState == InputPanelShown) {
-        QMap<QString, QVariant> stateInformation = getStateInformation();
+        QMap<QString, QVariant> stateInformation = currentStateInformation();
         updateStateInfo(stateInformation, true);
 
         showInputPanel();
@@ -259,19 +767,279 @@ void MInputContext::onDBusConnection()
     }
 }
 
+void MInputContext::setServerHeartbeat(int interval, int budget)
+{
+    if (debug) qDebug() << "setServerHeartbeat(), interval = " << interval << ", budget = " << budget;
+
+    imServer->setHeartbeat(interval, budget);
+}
+
+void MInputContext::onServerResponsivenessChanged(bool responsive)
+{
+    Q_UNUSED(responsive);
+}
+
+void MInputContext::onServerUnresponsive()
+{
+    if (debug) qDebug() << "onServerUnresponsive()";
+
+    Maliit::InputContext::TraceSpan span("onServerResponsivenessChanged", "embedder");
+    onServerResponsivenessChanged(false);
+}
+
+void MInputContext::onServerResponsive()
+{
+    if (debug) qDebug() << "onServerResponsive()";
+
+    Maliit::InputContext::TraceSpan span("onServerResponsivenessChanged", "embedder");
+    onServerResponsivenessChanged(true);
+}
+
+void MInputContext::registerAttributeExtension(int id, const QString &fileName)
+{
+    if (debug) qDebug() << "registerAttributeExtension(), id = " << id << ", fileName = " << fileName;
+
+    imServer->registerAttributeExtension(id, fileName);
+}
+
+void MInputContext::unregisterAttributeExtension(int id)
+{
+    if (debug) qDebug() << "unregisterAttributeExtension(), id = " << id;
+
+    imServer->unregisterAttributeExtension(id);
+}
+
+void MInputContext::setExtendedAttribute(int id, const QString &target, const QString &targetItem,
+                                         const QString &attribute, const QVariant &value)
+{
+    imServer->setExtendedAttribute(id, target, targetItem, attribute, value);
+}
+
+void MInputContext::extendedAttributeChanged(int id, const QString &target, const QString &targetItem,
+                                             const QString &attribute, const QVariant &value)
+{
+    if (debug) qDebug() << "extendedAttributeChanged(), id = " << id << ", attribute = " << attribute;
+    flushKeyRepeat();
+
+    Maliit::InputContext::TraceSpan span("onExtendedAttributeChanged", "embedder");
+    onExtendedAttributeChanged(id, target, targetItem, attribute, value);
+}
+
+void MInputContext::onExtendedAttributeChanged(int id, const QString &target, const QString &targetItem,
+                                               const QString &attribute, const QVariant &value)
+{
+    Q_UNUSED(id);
+    Q_UNUSED(target);
+    Q_UNUSED(targetItem);
+    Q_UNUSED(attribute);
+    Q_UNUSED(value);
+}
+
+void MInputContext::loadPluginSettings(const QString &descriptionLanguage)
+{
+    if (debug) qDebug() << "loadPluginSettings(), language = " << descriptionLanguage;
+
+    imServer->loadPluginSettings(descriptionLanguage);
+}
+
+void MInputContext::pluginSettingsReceived(const QList<MImPluginSettingsInfo> &info)
+{
+    if (debug) qDebug() << "pluginSettingsReceived(), plugins = " << info.size();
+    flushKeyRepeat();
+
+    Maliit::InputContext::TraceSpan span("onPluginSettingsReceived", "embedder");
+    onPluginSettingsReceived(info);
+}
+
+void MInputContext::onPluginSettingsReceived(const QList<MImPluginSettingsInfo> &info)
+{
+    Q_UNUSED(info);
+}
+
 void MInputContext::setRedirectKeys(bool enabled)
 {
-    if (debug) qDebug() << "unimplemented setRedirectKeys()";
+    if (debug) qDebug() << "setRedirectKeys(), enabled = " << enabled;
+    flushKeyRepeat();
+
+    mRedirectKeys = enabled;
+}
+
+void MInputContext::setRedirectKeyFilter(const QList<Maliit::KeyRedirectRule> &rules)
+{
+    if (debug) qDebug() << "setRedirectKeyFilter(), rules = " << rules.size();
+    flushKeyRepeat();
+
+    mRedirectRules = rules;
 }
 
 void MInputContext::setDetectableAutoRepeat(bool enabled)
 {
-    if (debug) qDebug() << "unimplemented setDetectableAutoRepeat()";
+    if (debug) qDebug() << "setDetectableAutoRepeat(), enabled = " << enabled;
+    flushKeyRepeat();
+
+    mDetectableAutoRepeat = enabled;
+}
+
+bool MInputContext::isRedirectedKey(Qt::Key keyCode, Qt::KeyboardModifiers modifiers) const
+{
+    if (mRedirectRules.isEmpty()) {
+        return true;
+    }
+
+    const int contentTypeBit = (mContentType >= 0 && mContentType < 31) ? 1 << mContentType : 0;
+
+    Q_FOREACH (const Maliit::KeyRedirectRule &rule, mRedirectRules) {
+        if (rule.key != 0 && rule.key != keyCode) {
+            continue;
+        }
+        if ((static_cast<int>(modifiers) & rule.modifierMask) != (rule.modifiers & rule.modifierMask)) {
+            continue;
+        }
+        if (rule.contentTypes != 0 && !(rule.contentTypes & contentTypeBit)) {
+            continue;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool MInputContext::filterKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
+                                   Qt::KeyboardModifiers modifiers,
+                                   const QString &text, bool autoRepeat, int count,
+                                   quint32 nativeScanCode, quint32 nativeModifiers,
+                                   unsigned long time)
+{
+    if (!mServerAvailable || (keyType == QEvent::KeyRelease && mOfflineKeys.contains(keyCode))) {
+        return handleOfflineKey(keyType, keyCode, modifiers, text, autoRepeat);
+    }
+
+    if (!active || !mRedirectKeys) {
+        return false;
+    }
+
+    bool redirect;
+    if (keyType == QEvent::KeyRelease) {
+        // With detectable autorepeat the server expects press, press, ...,
+        // release; the synthetic releases in between are never sent.
+        if (autoRepeat && mDetectableAutoRepeat) {
+            return mRedirectedKeys.contains(keyCode);
+        }
+        // Modifiers may have changed since the press, so the release follows
+        // wherever its press went instead of being matched again.
+        redirect = autoRepeat ? mRedirectedKeys.contains(keyCode)
+                              : mRedirectedKeys.remove(keyCode);
+    } else {
+        redirect = isRedirectedKey(keyCode, modifiers);
+        if (redirect) {
+            mRedirectedKeys.insert(keyCode);
+        }
+    }
+
+    if (debug) qDebug() << "filterKeyEvent(), key = " << keyCode << ", redirect = " << redirect;
+
+    if (redirect) {
+        imServer->processKeyEvent(keyType, keyCode, modifiers, text, autoRepeat, count,
+                                  nativeScanCode, nativeModifiers, time);
+        if (keyType == QEvent::KeyPress && isEchoedKey(modifiers, text)) {
+            echoKey(text);
+        }
+    }
+
+    return redirect;
+}
+
+void MInputContext::setOfflineFallbackEnabled(bool enabled)
+{
+    if (debug) qDebug() << "setOfflineFallbackEnabled(), enabled = " << enabled;
+
+    mOfflineFallback = enabled;
+}
+
+bool MInputContext::handleOfflineKey(QEvent::Type keyType, Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                                     const QString &text, bool autoRepeat)
+{
+    if (keyType == QEvent::KeyRelease) {
+        // Released wherever the press went, even if the server is back
+        if (!mOfflineKeys.contains(keyCode)) {
+            return false;
+        }
+        if (!autoRepeat) {
+            mOfflineKeys.remove(keyCode);
+        }
+        if (isOfflineEditingKey(keyCode)) {
+            Maliit::InputContext::TraceSpan span("onKeyEvent", "embedder");
+            onKeyEvent(keyCode, false, 1, autoRepeat, modifiers);
+        }
+        return true;
+    }
+
+    if (!mOfflineFallback || inputPanelState == InputPanelHidden) {
+        return false;
+    }
+
+    if (debug) qDebug() << "handleOfflineKey(), key = " << keyCode;
+
+    if (isOfflineEditingKey(keyCode)) {
+        mOfflineKeys.insert(keyCode);
+        Maliit::InputContext::TraceSpan span("onKeyEvent", "embedder");
+        onKeyEvent(keyCode, true, 1, autoRepeat, modifiers);
+        return true;
+    }
+
+    if (isOfflineText(modifiers, text)) {
+        mOfflineKeys.insert(keyCode);
+        Maliit::InputContext::TraceSpan span("onCommitString", "embedder");
+        onCommitString(text, 0, 0, -1);
+        return true;
+    }
+
+    return false;
+}
+
+void MInputContext::setLocalEchoEnabled(bool enabled)
+{
+    if (debug) qDebug() << "setLocalEchoEnabled(), enabled = " << enabled;
+
+    mLocalEcho = enabled;
+}
+
+bool MInputContext::isEchoedKey(Qt::KeyboardModifiers modifiers, const QString &text) const
+{
+    if (!mLocalEcho || text.isEmpty()) {
+        return false;
+    }
+
+    // Engines may rewrite anything beyond plain text
+    if (mContentType != Maliit::FreeTextContentType
+        && mContentType != Maliit::EmailContentType
+        && mContentType != Maliit::UrlContentType) {
+        return false;
+    }
+    if (modifiers & ~(Qt::ShiftModifier | Qt::KeypadModifier)) {
+        return false;
+    }
+
+    Q_FOREACH (const QChar &character, text) {
+        if (!character.isLetterOrNumber()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MInputContext::echoKey(const QString &text)
+{
+    mEchoText += text;
+
+    Maliit::InputContext::TraceSpan span("onUpdatePreedit", "embedder");
+    onUpdatePreedit(preedit + mEchoText, 0, 0, -1);
 }
 
 void MInputContext::setSelection(int start, int length)
 {
     if (debug) qDebug() << "unimplemented setSelection()";
+    flushKeyRepeat();
 }
 
 void MInputContext::getSelection(QString &selection, bool &valid) const
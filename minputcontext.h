@@ -21,9 +21,12 @@
 
 #include "dbusserverconnection.h"
 
+#include <QElapsedTimer>
 #include <QMetaType>
 #include <QObject>
 #include <QRect>
+#include <QSet>
+#include <QTimer>
 
 class MInputContext : public QObject
 {
@@ -37,7 +40,8 @@ public:
         Angle270 = 270
     };
 
-    MInputContext();
+    //! \brief Connects to the server of \a seat, see Maliit::InputContext::SeatRouter
+    explicit MInputContext(const QString &seat = QString());
     virtual ~MInputContext();
 
     Q_INVOKABLE void reset();
@@ -45,6 +49,82 @@ public:
     Q_INVOKABLE void hideInputPanel();
     Q_INVOKABLE void updateServerOrientation(MInputContext::OrientationAngle angle);
     Q_INVOKABLE void updateStateInfo(QMap<QString, QVariant> stateInfo, bool focusChanged);
+    Q_INVOKABLE void updateCopyPasteState(bool copyAvailable, bool pasteAvailable);
+    //! \brief Reports an edit of the surrounding text, see DBusServerConnection::updateSurroundingText()
+    Q_INVOKABLE void updateSurroundingText(int start, int length, const QString &text, int cursor, int anchor);
+
+    /*!
+     * \brief Holds back state updates while the context is inactive or its panel hidden.
+     *
+     * Enabled by default.  State information and copy/paste availability
+     * are then only kept locally until the next showInputPanel(), which sends
+     * the latest values along with the activation.  Inactive contexts and
+     * hidden panels do not cause any state traffic to the server.
+     */
+    Q_INVOKABLE void setTrafficGatingEnabled(bool enabled);
+
+    /*!
+     * \brief Variants returning a handle that finishes once the server handled the request.
+     *
+     * The handle of showInputPanelAsync() tracks the activation of the
+     * context, it finishes right away if the context is already active.
+     * updateStateInfoAsync() is sent even if traffic gating would hold it back.
+     * See Maliit::InputContext::Completion for callbacks and co_await.
+     */
+    Maliit::InputContext::Completion resetAsync();
+    Maliit::InputContext::Completion showInputPanelAsync();
+    Maliit::InputContext::Completion updateStateInfoAsync(const QMap<QString, QVariant> &stateInfo,
+                                                          bool focusChanged);
+    //! \brief Enables server liveness probing, see DBusServerConnection::setHeartbeat()
+    Q_INVOKABLE void setServerHeartbeat(int interval, int budget);
+
+    // Attribute extensions, e.g. custom labels for action keys
+    Q_INVOKABLE void registerAttributeExtension(int id, const QString &fileName);
+    Q_INVOKABLE void unregisterAttributeExtension(int id);
+    Q_INVOKABLE void setExtendedAttribute(int id, const QString &target, const QString &targetItem,
+                                          const QString &attribute, const QVariant &value);
+
+    //! \brief Requests the server settings, answered by onPluginSettingsReceived()
+    Q_INVOKABLE void loadPluginSettings(const QString &descriptionLanguage);
+
+    //! \brief Measures input to display latency, reported by onInputLatency()
+    Q_INVOKABLE void setInputLatencyTracking(bool enabled);
+
+    /*!
+     * \brief Shows typed characters before the server answered.
+     *
+     * Disabled by default.  Letters and digits redirected through
+     * filterKeyEvent() into free text, email or URL fields are appended to the
+     * preedit right away.  Preedits and commits from the server replace the
+     * echoed text once they cover it, without repainting text that is already
+     * shown; if the server produced something else, its result wins.
+     */
+    Q_INVOKABLE void setLocalEchoEnabled(bool enabled);
+
+    /*!
+     * \brief Keeps hardware key input working while the server is unavailable.
+     *
+     * Disabled by default.  While disconnected, filterKeyEvent() commits
+     * printable keys itself and reports editing keys such as backspace,
+     * return and the arrows through onKeyEvent(), as the server would, for as
+     * long as the input panel was requested.  A preedit left over by the lost
+     * server is committed instead of being dropped.  Input goes back to the
+     * server as soon as it is connected again.
+     */
+    Q_INVOKABLE void setOfflineFallbackEnabled(bool enabled);
+
+    /*!
+     * \brief Offers a hardware key event to the input method server.
+     *
+     * Returns true if the event was consumed, either redirected to the server
+     * or dropped as a synthetic autorepeat release, and false if the
+     * application should handle the key itself.
+     */
+    Q_INVOKABLE bool filterKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
+                                    Qt::KeyboardModifiers modifiers,
+                                    const QString &text, bool autoRepeat, int count,
+                                    quint32 nativeScanCode, quint32 nativeModifiers,
+                                    unsigned long time);
 
     virtual void onHideInputMethod() = 0;
     virtual void onCommitString(const QString &string,
@@ -52,9 +132,48 @@ public:
     virtual void onUpdatePreedit(const QString &string,
                        int replacementStart, int replacementLength, int cursorPos) = 0;
     virtual void onKeyEvent(int key, bool down)= 0;
+    /*!
+     * \brief Key event from the input method, with autorepeat bursts merged.
+     *
+     * Adjacent autorepeat presses of the same non-printable key that arrive
+     * together are reported once, with \a count holding the number of
+     * repeats, so that e.g. a held backspace can be applied in one pass.
+     * Unless keyRepeatPaired() is false, as with detectable autorepeat, each
+     * repeat but the last was followed by its release; the release of the
+     * last one is reported on its own.  \a count is 1 for other events.
+     * The default implementation replays the presses and releases through
+     * onKeyEvent(key, down).
+     */
+    virtual void onKeyEvent(int key, bool down, int count, bool autoRepeat,
+                            Qt::KeyboardModifiers modifiers);
+    //! \brief Whether the repeats of the burst being reported came with releases
+    bool keyRepeatPaired() const;
     virtual void onUpdateInputMethodArea(int x, int y, int w, int h) = 0;
     virtual void onConnectionReady() = 0;
     virtual QMap<QString, QVariant> getStateInformation() = 0;
+    //! \brief Called when the server stops or resumes answering liveness probes
+    virtual void onServerResponsivenessChanged(bool responsive);
+    //! \brief Called when the input method server changed an extended attribute
+    virtual void onExtendedAttributeChanged(int id, const QString &target, const QString &targetItem,
+                                            const QString &attribute, const QVariant &value);
+    //! \brief Called with cached settings first, and again when the server reports changes
+    virtual void onPluginSettingsReceived(const QList<MImPluginSettingsInfo> &info);
+    //! \brief Called once the event caused by the input stamped \a id was handled,
+    //! \a latency is the time in ns since that input was sent to the server
+    virtual void onInputLatency(quint32 id, qint64 latency);
+
+    //! \brief Time in ms from the start of the last rotation until the server
+    //! re-laid out the input method area, or -1 if not measured yet.
+    qint64 orientationChangeLatency() const;
+
+    //! \brief Last latency passed to onInputLatency() in ns, or -1 if not measured yet.
+    qint64 inputLatency() const;
+
+    // Health of the connection to the server, see DBusServerConnection
+    const Maliit::InputContext::ConnectionCounters &counters() const;
+    DBusServerConnection::QueueStatistics queueStatistics() const;
+    DBusServerConnection::ConnectTimings connectTimings() const;
+    qint64 recoveryTime() const;
 
 public Q_SLOTS:
     // Hooked up to the input method server
@@ -74,15 +193,24 @@ public Q_SLOTS:
     void setGlobalCorrectionEnabled(bool);
     void onInvokeAction(const QString &action, const QKeySequence &sequence);
     void setRedirectKeys(bool enabled);
+    void setRedirectKeyFilter(const QList<Maliit::KeyRedirectRule> &rules);
     void setDetectableAutoRepeat(bool enabled);
     void setSelection(int start, int length);
     void getSelection(QString &selection, bool &valid) const;
     void setLanguage(const QString &language);
+    void extendedAttributeChanged(int id, const QString &target, const QString &targetItem,
+                                  const QString &attribute, const QVariant &value);
+    void pluginSettingsReceived(const QList<MImPluginSettingsInfo> &info);
+    void eventStamp(quint32 id);
     // End input method server connection slots.
 
 private Q_SLOTS:
     void onDBusDisconnection();
     void onDBusConnection();
+    void onServerUnresponsive();
+    void onServerResponsive();
+    void commitServerOrientation();
+    void flushKeyRepeat();
 
 private:
     Q_DISABLE_COPY(MInputContext)
@@ -94,6 +222,19 @@ private:
     };
 
     void connectInputMethodServer();
+    void cancelOrientationChange();
+    Maliit::InputContext::Completion sendStateInfo(const QMap<QString, QVariant> &stateInfo,
+                                                   bool focusChanged, bool track);
+    Maliit::InputContext::Completion activateAndShow(bool trackActivation);
+    bool trafficHeld() const;
+    void sendPendingState();
+    bool isRedirectedKey(Qt::Key keyCode, Qt::KeyboardModifiers modifiers) const;
+    bool isEchoedKey(Qt::KeyboardModifiers modifiers, const QString &text) const;
+    void echoKey(const QString &text);
+    bool handleOfflineKey(QEvent::Type keyType, Qt::Key keyCode, Qt::KeyboardModifiers modifiers,
+                          const QString &text, bool autoRepeat);
+    void reportInputLatency();
+    QMap<QString, QVariant> currentStateInformation();
 
     static bool debug;
 
@@ -103,6 +244,37 @@ private:
     bool mIMServerRestart; // Maliit server crashes/restart
     QString preedit;
     MInputContext::OrientationAngle mAngle;
+    int mServerAngle; // angle last committed to the server
+    int mAnnouncedAngle; // angle last pre-announced during a rotation
+    QTimer orientationTimer;
+    QElapsedTimer orientationClock;
+    bool mOrientationLayoutPending;
+    qint64 mOrientationLatency;
+    bool mRedirectKeys;
+    bool mDetectableAutoRepeat;
+    QList<Maliit::KeyRedirectRule> mRedirectRules;
+    QSet<int> mRedirectedKeys; // keys pressed while redirected, their release follows them
+    int mContentType; // Maliit::TextContentType of the focused widget
+    QTimer keyRepeatTimer;
+    int mRepeatKey;
+    Qt::KeyboardModifiers mRepeatModifiers;
+    int mRepeatCount; // merged autorepeat presses not yet reported, 0 if none
+    bool mRepeatReleased; // the burst ended with an autorepeat release
+    bool mRepeatPaired; // each press of the burst is followed by a release
+    quint32 mEventStamp; // input the next delivered event was caused by, 0 if none
+    qint64 mInputLatency;
+    bool mTrafficGating;
+    bool mLocalEcho;
+    QString mEchoText; // typed after preedit, not covered by the server yet
+    bool mServerAvailable;
+    bool mOfflineFallback;
+    QSet<int> mOfflineKeys; // keys pressed while handled locally, their release follows them
+    QMap<QString, QVariant> mPendingStateInfo; // held back while inactive
+    bool mStateInfoPending;
+    bool mPendingFocusChange;
+    bool mCopyAvailable;
+    bool mPasteAvailable;
+    bool mCopyPastePending;
 };
 
 Q_DECLARE_METATYPE(MInputContext::OrientationAngle)
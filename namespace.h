@@ -122,6 +122,29 @@ namespace Maliit {
         {};
     };
 
+    /*!
+     * \brief Hardware key the input method server wants redirected to it.
+     *
+     * A key matches when its code equals \a key (or \a key is 0), its
+     * modifiers masked by \a modifierMask equal \a modifiers, and the focused
+     * widget's content type is in \a contentTypes, a mask of
+     * (1 << TextContentType) bits where 0 stands for any content type.
+     */
+    struct KeyRedirectRule {
+        int key;
+        int modifiers;
+        int modifierMask;
+        int contentTypes;
+
+        KeyRedirectRule()
+            : key(0), modifiers(0), modifierMask(0), contentTypes(0)
+        {};
+
+        KeyRedirectRule(int k, int m, int mask, int types)
+            : key(k), modifiers(m), modifierMask(mask), contentTypes(types)
+        {};
+    };
+
     namespace InputMethodQuery
     {
         //! Name of property which tells whether correction is enabled.
@@ -175,5 +198,7 @@ namespace Maliit {
 Q_DECLARE_METATYPE(Maliit::TextContentType)
 Q_DECLARE_METATYPE(Maliit::PreeditTextFormat)
 Q_DECLARE_METATYPE(QList<Maliit::PreeditTextFormat>)
+Q_DECLARE_METATYPE(Maliit::KeyRedirectRule)
+Q_DECLARE_METATYPE(QList<Maliit::KeyRedirectRule>)
 
 #endif
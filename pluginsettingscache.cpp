@@ -0,0 +1,163 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "pluginsettingscache.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace
+{
+    const quint32 CacheMagic(0x4d505343); // "MPSC"
+    const quint32 CacheFormatVersion(1);
+    const char * const CacheDirectory("/maliit/");
+    const char * const CacheFilePrefix("pluginsettings-");
+
+    struct CacheEntry
+    {
+        QString serverVersion;
+        QList<MImPluginSettingsInfo> info;
+    };
+
+    typedef QHash<QString, CacheEntry> CacheEntries;
+    Q_GLOBAL_STATIC(CacheEntries, cacheEntries)
+    Q_GLOBAL_STATIC(QMutex, cacheMutex)
+
+    QString cacheFileName(const QString &language)
+    {
+        QString name(language);
+        for (QString::iterator it = name.begin(); it != name.end(); ++it) {
+            if (!it->isLetterOrNumber() && *it != QLatin1Char('_') && *it != QLatin1Char('-')) {
+                *it = QLatin1Char('_');
+            }
+        }
+
+        return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                + QLatin1String(CacheDirectory) + QLatin1String(CacheFilePrefix) + name;
+    }
+}
+
+namespace Maliit {
+namespace InputContext {
+
+bool PluginSettingsCache::load(const QString &language, QString &serverVersion,
+                               QList<MImPluginSettingsInfo> &info)
+{
+    QMutexLocker locker(cacheMutex());
+
+    CacheEntries::const_iterator cached = cacheEntries()->constFind(language);
+    if (cached != cacheEntries()->constEnd()) {
+        serverVersion = cached->serverVersion;
+        info = cached->info;
+        return true;
+    }
+
+    QFile file(cacheFileName(language));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic;
+    quint32 formatVersion;
+    QString fileLanguage;
+    CacheEntry entry;
+    stream >> magic >> formatVersion;
+    if (magic != CacheMagic || formatVersion != CacheFormatVersion)
+        return false;
+
+    stream >> fileLanguage >> entry.serverVersion >> entry.info;
+    if (stream.status() != QDataStream::Ok || fileLanguage != language)
+        return false;
+
+    cacheEntries()->insert(language, entry);
+    serverVersion = entry.serverVersion;
+    info = entry.info;
+    return true;
+}
+
+void PluginSettingsCache::store(const QString &language, const QString &serverVersion,
+                                const QList<MImPluginSettingsInfo> &info)
+{
+    QMutexLocker locker(cacheMutex());
+
+    CacheEntry entry;
+    entry.serverVersion = serverVersion;
+    entry.info = info;
+    cacheEntries()->insert(language, entry);
+
+    const QString fileName(cacheFileName(language));
+    QDir().mkpath(fileName.left(fileName.lastIndexOf(QLatin1Char('/'))));
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << CacheMagic << CacheFormatVersion << language << serverVersion << info;
+    if (stream.status() == QDataStream::Ok) {
+        file.commit();
+    }
+}
+
+bool PluginSettingsCache::merge(QList<MImPluginSettingsInfo> &info,
+                                const QList<MImPluginSettingsInfo> &update, bool complete)
+{
+    bool changed = false;
+
+    if (complete) {
+        for (int i = info.size() - 1; i >= 0; --i) {
+            bool found = false;
+            Q_FOREACH (const MImPluginSettingsInfo &plugin, update) {
+                if (plugin.plugin_name == info.at(i).plugin_name) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                info.removeAt(i);
+                changed = true;
+            }
+        }
+    }
+
+    Q_FOREACH (const MImPluginSettingsInfo &plugin, update) {
+        bool found = false;
+        for (int i = 0; i < info.size() && !found; ++i) {
+            if (info.at(i).plugin_name != plugin.plugin_name)
+                continue;
+
+            found = true;
+            if (info.at(i) != plugin) {
+                info[i] = plugin;
+                changed = true;
+            }
+        }
+        if (!found) {
+            info.append(plugin);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+} // namespace InputContext
+} // namespace Maliit
@@ -0,0 +1,49 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_PLUGINSETTINGSCACHE_H
+#define MALIIT_INPUTCONTEXT_PLUGINSETTINGSCACHE_H
+
+#include "settingdata.h"
+
+namespace Maliit {
+namespace InputContext {
+
+/*! \brief Process wide, disk backed cache of the server's settings description.
+ *
+ * Entries are kept per description language, together with the version of the
+ * server that described them.  Files live in the generic cache location and
+ * are discarded when their format version does not match.
+ */
+class PluginSettingsCache
+{
+public:
+    static bool load(const QString &language, QString &serverVersion,
+                     QList<MImPluginSettingsInfo> &info);
+    static void store(const QString &language, const QString &serverVersion,
+                      const QList<MImPluginSettingsInfo> &info);
+
+    /*! \brief Applies settings sent by the server to \a info.
+     *
+     * Plugins are matched by name.  When \a complete is true, \a update is the
+     * full list and plugins missing from it are removed.
+     * \return whether \a info changed
+     */
+    static bool merge(QList<MImPluginSettingsInfo> &info,
+                      const QList<MImPluginSettingsInfo> &update, bool complete);
+};
+
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_PLUGINSETTINGSCACHE_H
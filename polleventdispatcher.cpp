@@ -0,0 +1,281 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "polleventdispatcher.h"
+
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QDebug>
+
+#include <climits>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+    short pollEvents(QSocketNotifier::Type type)
+    {
+        switch (type) {
+        case QSocketNotifier::Read:
+            return POLLIN;
+        case QSocketNotifier::Write:
+            return POLLOUT;
+        case QSocketNotifier::Exception:
+            return POLLPRI;
+        }
+        return 0;
+    }
+}
+
+namespace Maliit {
+namespace InputContext {
+
+PollEventDispatcher::PollEventDispatcher(QObject *parent)
+    : QAbstractEventDispatcher(parent)
+    , mClock()
+    , mNotifiers()
+    , mTimers()
+    , mWakeUpDescriptor(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+    , mInterrupted(0)
+    , mPosted(1)
+{
+    if (mWakeUpDescriptor < 0) {
+        qWarning() << "Maliit: cannot create wakeup descriptor:" << qt_error_string(errno);
+    }
+    mClock.start();
+}
+
+PollEventDispatcher::~PollEventDispatcher()
+{
+    if (mWakeUpDescriptor >= 0) {
+        close(mWakeUpDescriptor);
+    }
+}
+
+QVector<pollfd> PollEventDispatcher::descriptors() const
+{
+    QVector<pollfd> result;
+    result.reserve(mNotifiers.size() + 1);
+
+    const pollfd wakeUp = { mWakeUpDescriptor, POLLIN, 0 };
+    result.append(wakeUp);
+
+    Q_FOREACH (QSocketNotifier *notifier, mNotifiers) {
+        const pollfd descriptor = { static_cast<int>(notifier->socket()), pollEvents(notifier->type()), 0 };
+        result.append(descriptor);
+    }
+    return result;
+}
+
+int PollEventDispatcher::nextTimeout() const
+{
+    if (mPosted.loadAcquire()) {
+        return 0;
+    }
+
+    qint64 timeout = -1;
+    const qint64 now = mClock.elapsed();
+    Q_FOREACH (const Timer &timer, mTimers) {
+        const qint64 remaining = qMax<qint64>(timer.deadline - now, 0);
+        if (timeout < 0 || remaining < timeout) {
+            timeout = remaining;
+        }
+    }
+    return static_cast<int>(qMin<qint64>(timeout, INT_MAX));
+}
+
+bool PollEventDispatcher::dispatch()
+{
+    return dispatch(0, QEventLoop::AllEvents);
+}
+
+bool PollEventDispatcher::dispatch(int timeout, QEventLoop::ProcessEventsFlags flags)
+{
+    // Posted events may add or remove notifiers before the ready ones are
+    // handled, the descriptors are matched against the notifiers polled
+    const QList<QSocketNotifier *> notifiers(mNotifiers);
+    QVector<pollfd> ready = descriptors();
+    if (flags & QEventLoop::ExcludeSocketNotifiers) {
+        ready.resize(1);
+    }
+
+    int count;
+    do {
+        count = ::poll(ready.data(), ready.size(), timeout);
+    } while (count < 0 && errno == EINTR);
+
+    Q_EMIT awake();
+
+    bool handled = false;
+    if (count > 0 && (ready.at(0).revents & POLLIN)) {
+        eventfd_t value;
+        eventfd_read(mWakeUpDescriptor, &value);
+    }
+
+    // Cleared first, events posted while these are sent wake up the next
+    // iteration
+    if (mPosted.fetchAndStoreAcquire(0)) {
+        QCoreApplication::sendPostedEvents();
+        handled = true;
+    }
+
+    if (count > 0) {
+        // Notifiers may go away while earlier ones are handled
+        for (int i = 1; i < ready.size(); ++i) {
+            if (!(ready.at(i).revents & (ready.at(i).events | POLLERR | POLLHUP))) {
+                continue;
+            }
+            QSocketNotifier *notifier = notifiers.at(i - 1);
+            if (mNotifiers.contains(notifier)) {
+                QEvent event(QEvent::SockAct);
+                QCoreApplication::sendEvent(notifier, &event);
+                handled = true;
+            }
+        }
+    }
+
+    return activateTimers() || handled;
+}
+
+bool PollEventDispatcher::activateTimers()
+{
+    const qint64 now = mClock.elapsed();
+
+    QList<int> due;
+    Q_FOREACH (const Timer &timer, mTimers) {
+        if (timer.deadline <= now) {
+            due.append(timer.id);
+        }
+    }
+
+    // Timers may be unregistered by the handlers of earlier ones
+    Q_FOREACH (int id, due) {
+        for (QList<Timer>::iterator it = mTimers.begin(); it != mTimers.end(); ++it) {
+            if (it->id != id) {
+                continue;
+            }
+            it->deadline = now + it->interval;
+            QObject *object = it->object;
+            QTimerEvent event(id);
+            QCoreApplication::sendEvent(object, &event);
+            break;
+        }
+    }
+    return !due.isEmpty();
+}
+
+bool PollEventDispatcher::processEvents(QEventLoop::ProcessEventsFlags flags)
+{
+    mInterrupted.storeRelease(0);
+
+    const bool wait = (flags & QEventLoop::WaitForMoreEvents) && !hasPendingEvents();
+    const int timeout = wait ? nextTimeout() : 0;
+    if (timeout != 0) {
+        Q_EMIT aboutToBlock();
+    }
+
+    return dispatch(mInterrupted.loadAcquire() ? 0 : timeout, flags);
+}
+
+bool PollEventDispatcher::hasPendingEvents()
+{
+    return mPosted.loadAcquire();
+}
+
+void PollEventDispatcher::registerSocketNotifier(QSocketNotifier *notifier)
+{
+    mNotifiers.append(notifier);
+}
+
+void PollEventDispatcher::unregisterSocketNotifier(QSocketNotifier *notifier)
+{
+    mNotifiers.removeAll(notifier);
+}
+
+void PollEventDispatcher::registerTimer(int timerId, int interval, Qt::TimerType timerType, QObject *object)
+{
+    const Timer timer = { timerId, interval, timerType, object, mClock.elapsed() + interval };
+    mTimers.append(timer);
+}
+
+bool PollEventDispatcher::unregisterTimer(int timerId)
+{
+    for (QList<Timer>::iterator it = mTimers.begin(); it != mTimers.end(); ++it) {
+        if (it->id == timerId) {
+            mTimers.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PollEventDispatcher::unregisterTimers(QObject *object)
+{
+    bool removed = false;
+    for (QList<Timer>::iterator it = mTimers.begin(); it != mTimers.end();) {
+        if (it->object == object) {
+            it = mTimers.erase(it);
+            removed = true;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+QList<QAbstractEventDispatcher::TimerInfo> PollEventDispatcher::registeredTimers(QObject *object) const
+{
+    QList<TimerInfo> result;
+    Q_FOREACH (const Timer &timer, mTimers) {
+        if (timer.object == object) {
+            result.append(TimerInfo(timer.id, timer.interval, timer.type));
+        }
+    }
+    return result;
+}
+
+int PollEventDispatcher::remainingTime(int timerId)
+{
+    Q_FOREACH (const Timer &timer, mTimers) {
+        if (timer.id == timerId) {
+            return static_cast<int>(qMax<qint64>(timer.deadline - mClock.elapsed(), 0));
+        }
+    }
+    return -1;
+}
+
+void PollEventDispatcher::wakeUp()
+{
+    // May be called from any thread, Qt does so for every event posted to
+    // the thread of this dispatcher
+    mPosted.storeRelease(1);
+    if (mWakeUpDescriptor >= 0) {
+        eventfd_write(mWakeUpDescriptor, 1);
+    }
+}
+
+void PollEventDispatcher::interrupt()
+{
+    mInterrupted.storeRelease(1);
+    if (mWakeUpDescriptor >= 0) {
+        eventfd_write(mWakeUpDescriptor, 1);
+    }
+}
+
+void PollEventDispatcher::flush()
+{
+}
+
+} // namespace InputContext
+} // namespace Maliit
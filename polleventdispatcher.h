@@ -0,0 +1,104 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_POLLEVENTDISPATCHER_H
+#define MALIIT_INPUTCONTEXT_POLLEVENTDISPATCHER_H
+
+#include <QAbstractEventDispatcher>
+#include <QElapsedTimer>
+#include <QList>
+#include <QVector>
+
+#include <poll.h>
+
+class QSocketNotifier;
+
+namespace Maliit {
+namespace InputContext {
+
+/*! \brief Event dispatcher driven by the application's own main loop.
+ *
+ * The connection relies on Qt for its socket, timers and queued calls.  Hosts
+ * that run their own poll or epoll loop install this dispatcher instead of
+ * running a Qt event loop:
+ *
+ * \code
+ * QCoreApplication::setEventDispatcher(new PollEventDispatcher); // before the application object
+ * ...
+ * // every iteration of the host loop
+ * QVector<pollfd> fds = dispatcher->descriptors();
+ * // add fds to the host's wait, wait at most dispatcher->nextTimeout() ms
+ * dispatcher->dispatch();
+ * \endcode
+ *
+ * dispatch() never blocks, so input is handled in the iteration it arrives
+ * in.  Calls arriving on another thread, such as the D-Bus thread, make the
+ * first descriptor readable.
+ */
+class PollEventDispatcher : public QAbstractEventDispatcher
+{
+    Q_OBJECT
+
+public:
+    explicit PollEventDispatcher(QObject *parent = 0);
+    virtual ~PollEventDispatcher();
+
+    //! \brief Descriptors to wait on, with the events of interest
+    QVector<pollfd> descriptors() const;
+    //! \brief Time in ms until dispatch() has work, 0 if now, -1 if only on a descriptor
+    int nextTimeout() const;
+    //! \brief Handles ready descriptors, due timers and posted events without blocking
+    bool dispatch();
+
+    //! reimpl
+    virtual bool processEvents(QEventLoop::ProcessEventsFlags flags);
+    virtual bool hasPendingEvents();
+    virtual void registerSocketNotifier(QSocketNotifier *notifier);
+    virtual void unregisterSocketNotifier(QSocketNotifier *notifier);
+    virtual void registerTimer(int timerId, int interval, Qt::TimerType timerType, QObject *object);
+    virtual bool unregisterTimer(int timerId);
+    virtual bool unregisterTimers(QObject *object);
+    virtual QList<TimerInfo> registeredTimers(QObject *object) const;
+    virtual int remainingTime(int timerId);
+    virtual void wakeUp();
+    virtual void interrupt();
+    virtual void flush();
+    //! reimpl end
+
+private:
+    Q_DISABLE_COPY(PollEventDispatcher)
+
+    struct Timer
+    {
+        int id;
+        int interval;
+        Qt::TimerType type;
+        QObject *object;
+        qint64 deadline; //!< in ms of mClock
+    };
+
+    bool dispatch(int timeout, QEventLoop::ProcessEventsFlags flags);
+    bool activateTimers();
+
+    QElapsedTimer mClock;
+    QList<QSocketNotifier *> mNotifiers;
+    QList<Timer> mTimers;
+    int mWakeUpDescriptor;
+    QAtomicInt mInterrupted;
+    QAtomicInt mPosted; //!< events were posted to this thread since they were last sent
+};
+
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_POLLEVENTDISPATCHER_H
@@ -0,0 +1,91 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "seatrouter.h"
+#include "dbusserverconnection.h"
+
+#include <QDebug>
+
+namespace
+{
+    Q_GLOBAL_STATIC(Maliit::InputContext::SeatRouter, seatRouter)
+}
+
+namespace Maliit {
+namespace InputContext {
+
+SeatRouter *SeatRouter::instance()
+{
+    return seatRouter();
+}
+
+void SeatRouter::addSeat(const QString &seat, const AddressFactory &factory)
+{
+    QMutexLocker locker(&mMutex);
+    mSeats.insert(seat, factory);
+}
+
+void SeatRouter::addSeat(const QString &seat, const QString &address)
+{
+    addSeat(seat, [address]() -> DBus::Address * { return new DBus::FixedAddress(address); });
+}
+
+void SeatRouter::removeSeat(const QString &seat)
+{
+    QMutexLocker locker(&mMutex);
+    mSeats.remove(seat);
+}
+
+QStringList SeatRouter::seats() const
+{
+    QMutexLocker locker(&mMutex);
+    return mSeats.keys();
+}
+
+void SeatRouter::setClock(const QSharedPointer<Clock> &clock)
+{
+    QMutexLocker locker(&mMutex);
+    mClock = clock;
+}
+
+DBusServerConnection *SeatRouter::createConnection(const QString &seat) const
+{
+    QMutexLocker locker(&mMutex);
+    const QHash<QString, AddressFactory>::const_iterator it = mSeats.constFind(seat);
+    const bool known = it != mSeats.constEnd();
+    const AddressFactory factory(known ? *it : AddressFactory());
+    const QSharedPointer<Clock> clock(mClock);
+    locker.unlock();
+
+    // Every connection resolves its own address, the signals of a shared
+    // one would reach all of them.
+    if (seat.isEmpty()) {
+        const QSharedPointer<DBus::Address> address(new DBus::DynamicAddress);
+        return new DBusServerConnection(address, clock);
+    }
+
+    // Falling back to the default server would quietly mix up the input of
+    // two displays
+    if (!known) {
+        qWarning() << "Maliit: no server registered for seat" << seat;
+        const QSharedPointer<DBus::Address> address(
+            new DBus::UnavailableAddress(QString::fromLatin1("unknown seat ") + seat));
+        return new DBusServerConnection(address, clock, seat);
+    }
+
+    const QSharedPointer<DBus::Address> address(factory());
+    return new DBusServerConnection(address, clock, seat);
+}
+
+} // namespace InputContext
+} // namespace Maliit
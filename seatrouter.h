@@ -0,0 +1,81 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_SEATROUTER_H
+#define MALIIT_INPUTCONTEXT_SEATROUTER_H
+
+#include "connectionclock.h"
+#include "inputcontextdbusaddress.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include <functional>
+
+class DBusServerConnection;
+
+namespace Maliit {
+namespace InputContext {
+
+/*! \brief Binds input contexts to the input method server of their seat.
+ *
+ * Setups driving several displays run one server per seat.  Seats are
+ * registered with the address of their server before input contexts are
+ * created for them, e.g. one per screen:
+ *
+ * \code
+ * SeatRouter::instance()->addSeat("left", "unix:path=/run/maliit/left");
+ * MInputContextImpl context("left");
+ * \endcode
+ *
+ * Each input context has its own DBusServerConnection, with its own peer
+ * connection, which resolves the address of its server on its own.  A slow
+ * or restarting server only affects the contexts of its own seat.  Contexts
+ * without a seat use the server announced on the session bus, as before;
+ * those of a seat that is not registered fail to connect.
+ *
+ * Seats can be set up from any thread.
+ */
+class SeatRouter
+{
+public:
+    //! \brief Creates a new address for each connection to a seat
+    typedef std::function<DBus::Address *()> AddressFactory;
+
+    static SeatRouter *instance();
+
+    void addSeat(const QString &seat, const AddressFactory &factory);
+    //! \brief Routes \a seat to the server listening on \a address
+    void addSeat(const QString &seat, const QString &address);
+    //! \brief Existing connections of \a seat are kept, new ones fail to connect
+    void removeSeat(const QString &seat);
+    QStringList seats() const;
+
+    //! \brief Times connection attempts of connections created from now on
+    void setClock(const QSharedPointer<Clock> &clock);
+
+    //! \brief New connection to the server of \a seat, owned by the caller
+    DBusServerConnection *createConnection(const QString &seat) const;
+
+private:
+    mutable QMutex mMutex;
+    QHash<QString, AddressFactory> mSeats;
+    QSharedPointer<Clock> mClock;
+};
+
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_SEATROUTER_H
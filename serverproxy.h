@@ -66,6 +66,22 @@ public:
 
     ~ComMeegoInputmethodUiserver1Interface();
 
+    static inline QVariant stateInformationArgument(const QMap<QString, QVariant> &stateInformation)
+    {
+        QDBusArgument map;
+        map.beginMap(QVariant::String, qMetaTypeId<QDBusVariant>());
+        for (QMap<QString, QVariant>::ConstIterator it = stateInformation.constBegin(), end = stateInformation.constEnd();
+             it != end; ++it) {
+            map.beginMapEntry();
+            map << it.key();
+            map << QDBusVariant(it.value());
+            map.endMapEntry();
+        }
+        map.endMap();
+
+        return QVariant::fromValue(map);
+    }
+
 public Q_SLOTS: // METHODS
     inline QDBusPendingReply<> activateContext()
     {
@@ -93,6 +109,13 @@ public Q_SLOTS: // METHODS
         return asyncCallWithArgumentList(QLatin1String("hideInputMethod"), argumentList);
     }
 
+    inline QDBusPendingReply<uint, uint, QString> negotiateProtocol(uint in0, uint in1)
+    {
+        QList<QVariant> argumentList;
+        argumentList << QVariant::fromValue(in0) << QVariant::fromValue(in1);
+        return asyncCallWithArgumentList(QLatin1String("negotiateProtocol"), argumentList);
+    }
+
     inline QDBusPendingReply<> mouseClickedOnPreedit(int in0, int in1, int in2, int in3, int in4, int in5)
     {
         QList<QVariant> argumentList;
@@ -124,19 +147,8 @@ public Q_SLOTS: // METHODS
     {
         QDBusMessage msg = QDBusMessage::createMethodCall(service(), path(), interface(), "updateWidgetInformation");
 
-        QDBusArgument map;
-        map.beginMap(QVariant::String, qMetaTypeId<QDBusVariant>());
-        for (QMap<QString, QVariant>::ConstIterator it = stateInformation.constBegin(), end = stateInformation.constEnd();
-             it != end; ++it) {
-            map.beginMapEntry();
-            map << it.key();
-            map << QDBusVariant(it.value());
-            map.endMapEntry();
-        }
-        map.endMap();
-
         QList<QVariant> args;
-        args << QVariant::fromValue(map) << QVariant(focusChanged);
+        args << stateInformationArgument(stateInformation) << QVariant(focusChanged);
         msg.setArguments(args);
         return connection().asyncCall(msg);
     }
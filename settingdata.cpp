@@ -0,0 +1,109 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "settingdata.h"
+
+#include <QDataStream>
+#include <QDBusArgument>
+#include <QDBusVariant>
+
+bool operator==(const MImPluginSettingsEntry &a, const MImPluginSettingsEntry &b)
+{
+    return a.description == b.description
+        && a.extension_key == b.extension_key
+        && a.type == b.type
+        && a.value == b.value
+        && a.attributes == b.attributes;
+}
+
+bool operator==(const MImPluginSettingsInfo &a, const MImPluginSettingsInfo &b)
+{
+    return a.description_language == b.description_language
+        && a.plugin_name == b.plugin_name
+        && a.plugin_description == b.plugin_description
+        && a.extension_id == b.extension_id
+        && a.entries == b.entries;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const MImPluginSettingsEntry &entry)
+{
+    argument.beginStructure();
+    argument << entry.description << entry.extension_key << static_cast<int>(entry.type)
+             << entry.value.isValid()
+             << QDBusVariant(entry.value.isValid() ? entry.value : QVariant(QString()))
+             << entry.attributes;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, MImPluginSettingsEntry &entry)
+{
+    int type;
+    bool valueValid;
+    QDBusVariant value;
+
+    argument.beginStructure();
+    argument >> entry.description >> entry.extension_key >> type >> valueValid >> value >> entry.attributes;
+    argument.endStructure();
+
+    entry.type = static_cast<Maliit::SettingEntryType>(type);
+    entry.value = valueValid ? value.variant() : QVariant();
+    return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const MImPluginSettingsInfo &info)
+{
+    argument.beginStructure();
+    argument << info.description_language << info.plugin_name << info.plugin_description
+             << info.extension_id << info.entries;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, MImPluginSettingsInfo &info)
+{
+    argument.beginStructure();
+    argument >> info.description_language >> info.plugin_name >> info.plugin_description
+             >> info.extension_id >> info.entries;
+    argument.endStructure();
+    return argument;
+}
+
+QDataStream &operator<<(QDataStream &stream, const MImPluginSettingsEntry &entry)
+{
+    return stream << entry.description << entry.extension_key << static_cast<qint32>(entry.type)
+                  << entry.value << entry.attributes;
+}
+
+QDataStream &operator>>(QDataStream &stream, MImPluginSettingsEntry &entry)
+{
+    qint32 type;
+    stream >> entry.description >> entry.extension_key >> type >> entry.value >> entry.attributes;
+    entry.type = static_cast<Maliit::SettingEntryType>(type);
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const MImPluginSettingsInfo &info)
+{
+    return stream << info.description_language << info.plugin_name << info.plugin_description
+                  << static_cast<qint32>(info.extension_id) << info.entries;
+}
+
+QDataStream &operator>>(QDataStream &stream, MImPluginSettingsInfo &info)
+{
+    qint32 extensionId;
+    stream >> info.description_language >> info.plugin_name >> info.plugin_description
+           >> extensionId >> info.entries;
+    info.extension_id = extensionId;
+    return stream;
+}
@@ -0,0 +1,88 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_SETTINGDATA_H
+#define MALIIT_SETTINGDATA_H
+
+#include "namespace.h"
+
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QVariant>
+
+class QDataStream;
+class QDBusArgument;
+
+/*!
+ * \brief Single configuration entry for an input method plugin
+ */
+struct MImPluginSettingsEntry
+{
+    //! Translated description
+    QString description;
+    //! Attribute extension key for this entry
+    QString extension_key;
+    //! Entry type
+    Maliit::SettingEntryType type;
+    //! Current value
+    QVariant value;
+    //! Allowed values and other constraints, see Maliit::SettingEntryAttributes
+    QVariantMap attributes;
+
+    MImPluginSettingsEntry()
+        : type(Maliit::StringType)
+    {}
+};
+
+/*!
+ * \brief Input method plugin settings, as described by the server
+ */
+struct MImPluginSettingsInfo
+{
+    //! Language of the translated descriptions
+    QString description_language;
+    //! Plugin name, or "server" for global settings
+    QString plugin_name;
+    //! Translated plugin description
+    QString plugin_description;
+    //! Attribute extension id for the entries
+    int extension_id;
+    QList<MImPluginSettingsEntry> entries;
+
+    MImPluginSettingsInfo()
+        : extension_id(0)
+    {}
+};
+
+bool operator==(const MImPluginSettingsEntry &a, const MImPluginSettingsEntry &b);
+bool operator==(const MImPluginSettingsInfo &a, const MImPluginSettingsInfo &b);
+inline bool operator!=(const MImPluginSettingsInfo &a, const MImPluginSettingsInfo &b)
+{ return !(a == b); }
+
+// Marshalled as (ssibva{sv}) and (sssia(ssibva{sv})), b telling whether v holds a value
+QDBusArgument &operator<<(QDBusArgument &argument, const MImPluginSettingsEntry &entry);
+const QDBusArgument &operator>>(const QDBusArgument &argument, MImPluginSettingsEntry &entry);
+QDBusArgument &operator<<(QDBusArgument &argument, const MImPluginSettingsInfo &info);
+const QDBusArgument &operator>>(const QDBusArgument &argument, MImPluginSettingsInfo &info);
+
+QDataStream &operator<<(QDataStream &stream, const MImPluginSettingsEntry &entry);
+QDataStream &operator>>(QDataStream &stream, MImPluginSettingsEntry &entry);
+QDataStream &operator<<(QDataStream &stream, const MImPluginSettingsInfo &info);
+QDataStream &operator>>(QDataStream &stream, MImPluginSettingsInfo &info);
+
+Q_DECLARE_METATYPE(MImPluginSettingsEntry)
+Q_DECLARE_METATYPE(MImPluginSettingsInfo)
+Q_DECLARE_METATYPE(QList<MImPluginSettingsInfo>)
+
+#endif // MALIIT_SETTINGDATA_H
@@ -0,0 +1,159 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "bm_allocations.h"
+
+#include "allocationstats.h"
+#include "connectionclock.h"
+#include "dbusserverconnection.h"
+#include "faketransport.h"
+#include "manualaddress.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QPoint>
+#include <QRect>
+#include <QSignalSpy>
+#include <QtTest>
+
+namespace {
+    const char * const ServerAddress("fake:allocations");
+    const int Messages(1000); // per message type
+    const int StateEntries(16);
+
+    QMap<QString, QVariant> widgetState()
+    {
+        QMap<QString, QVariant> state;
+        for (int i = 0; i < StateEntries; ++i) {
+            state.insert(QString::fromLatin1("entry%1").arg(i), i);
+        }
+        return state;
+    }
+}
+
+void Bm_Allocations::initTestCase()
+{
+    QVERIFY(Maliit::InputContext::AllocationStatistics::enabled());
+}
+
+void Bm_Allocations::init()
+{
+    mClock = QSharedPointer<Maliit::InputContext::VirtualClock>(new Maliit::InputContext::VirtualClock);
+    mAddress = QSharedPointer<ManualAddress>(new ManualAddress);
+    mServer = QSharedPointer<FakeTransport>(new FakeTransport);
+    mConnection = new DBusServerConnection(mAddress, mClock, QString(), mServer);
+
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+    mClock->advance(0);
+    mAddress->resolve(QString::fromLatin1(ServerAddress));
+    processEvents();
+    QCOMPARE(connected.count(), 1);
+
+    // Only the messages of the test itself are counted, not the handshake
+    Maliit::InputContext::AllocationStatistics::reset();
+}
+
+void Bm_Allocations::cleanup()
+{
+    delete mConnection;
+    mConnection = 0;
+    processEvents();
+    mServer.clear();
+    mAddress.clear();
+    mClock.clear();
+}
+
+void Bm_Allocations::processEvents()
+{
+    QCoreApplication::processEvents();
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+void Bm_Allocations::sendMessages(const QString &messageType)
+{
+    const QMap<QString, QVariant> state(widgetState());
+    const QString preedit(QString::fromLatin1("preedit"));
+    const QString key(QString::fromLatin1("a"));
+
+    // The server answers in between, as it would, so every message after
+    // the first finds its argument list released again
+    for (int i = 0; i < Messages; ++i) {
+        if (messageType == QLatin1String("processKeyEvent")) {
+            mConnection->processKeyEvent(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, key, false, 1, 0, 0, 0);
+        } else if (messageType == QLatin1String("setPreedit")) {
+            mConnection->setPreedit(preedit, i % preedit.size());
+        } else if (messageType == QLatin1String("mouseClickedOnPreedit")) {
+            mConnection->mouseClickedOnPreedit(QPoint(i, i), QRect(0, 0, 100, 20));
+        } else if (messageType == QLatin1String("updateWidgetInformation")) {
+            mConnection->updateWidgetInformation(state, false);
+        } else if (messageType == QLatin1String("appOrientationChanged")) {
+            mConnection->appOrientationChanged((i % 4) * 90);
+        } else if (messageType == QLatin1String("setCopyPasteState")) {
+            mConnection->setCopyPasteState(i % 2, true);
+        } else if (messageType == QLatin1String("reset")) {
+            mConnection->reset(false);
+        }
+        processEvents();
+    }
+}
+
+void Bm_Allocations::benchmarkAllocationsPerMessage_data()
+{
+    QTest::addColumn<QString>("messageType");
+    QTest::newRow("processKeyEvent") << QString::fromLatin1("processKeyEvent");
+    QTest::newRow("setPreedit") << QString::fromLatin1("setPreedit");
+    QTest::newRow("mouseClickedOnPreedit") << QString::fromLatin1("mouseClickedOnPreedit");
+    QTest::newRow("updateWidgetInformation") << QString::fromLatin1("updateWidgetInformation");
+    QTest::newRow("appOrientationChanged") << QString::fromLatin1("appOrientationChanged");
+    QTest::newRow("setCopyPasteState") << QString::fromLatin1("setCopyPasteState");
+    QTest::newRow("reset") << QString::fromLatin1("reset");
+}
+
+void Bm_Allocations::benchmarkAllocationsPerMessage()
+{
+    QFETCH(QString, messageType);
+    sendMessages(messageType);
+
+    Q_FOREACH (const Maliit::InputContext::AllocationStatistics::Entry &entry,
+               Maliit::InputContext::AllocationStatistics::entries()) {
+        if (messageType == QLatin1String(entry.messageType)) {
+            QCOMPARE(entry.messages, quint64(Messages));
+            QTest::setBenchmarkResult(qreal(entry.allocations) / entry.messages, QTest::Events);
+            return;
+        }
+    }
+    QFAIL("no allocations accounted to the message");
+}
+
+void Bm_Allocations::benchmarkBytesPerMessage_data()
+{
+    benchmarkAllocationsPerMessage_data();
+}
+
+void Bm_Allocations::benchmarkBytesPerMessage()
+{
+    QFETCH(QString, messageType);
+    sendMessages(messageType);
+
+    Q_FOREACH (const Maliit::InputContext::AllocationStatistics::Entry &entry,
+               Maliit::InputContext::AllocationStatistics::entries()) {
+        if (messageType == QLatin1String(entry.messageType)) {
+            QCOMPARE(entry.messages, quint64(Messages));
+            QTest::setBenchmarkResult(qreal(entry.bytes) / entry.messages, QTest::BytesAllocated);
+            return;
+        }
+    }
+    QFAIL("no allocations accounted to the message");
+}
+
+QTEST_GUILESS_MAIN(Bm_Allocations)
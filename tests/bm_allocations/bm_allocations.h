@@ -0,0 +1,54 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef BM_ALLOCATIONS_H
+#define BM_ALLOCATIONS_H
+
+#include <QObject>
+#include <QSharedPointer>
+
+class DBusServerConnection;
+class FakeTransport;
+class ManualAddress;
+
+namespace Maliit {
+namespace InputContext {
+class VirtualClock;
+}
+}
+
+class Bm_Allocations : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void benchmarkAllocationsPerMessage_data();
+    void benchmarkAllocationsPerMessage();
+    void benchmarkBytesPerMessage_data();
+    void benchmarkBytesPerMessage();
+
+private:
+    void processEvents();
+    void sendMessages(const QString &messageType);
+
+    QSharedPointer<Maliit::InputContext::VirtualClock> mClock;
+    QSharedPointer<ManualAddress> mAddress;
+    QSharedPointer<FakeTransport> mServer;
+    DBusServerConnection *mConnection;
+};
+
+#endif // BM_ALLOCATIONS_H
@@ -0,0 +1,12 @@
+include(../common.pri)
+
+TARGET = bm_allocations
+
+# Counts every allocation, see allocationstats.h
+DEFINES += MALIIT_ALLOCATION_STATS
+
+HEADERS += \
+    bm_allocations.h \
+
+SOURCES += \
+    bm_allocations.cpp \
@@ -0,0 +1,163 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "bm_connect.h"
+
+#include "connectionclock.h"
+#include "dbusserverconnection.h"
+#include "faketransport.h"
+#include "manualaddress.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QSignalSpy>
+#include <QtTest>
+
+namespace {
+    const char * const KnownServerAddress("fake:known");
+    int serverSerial(0);
+    const int PhaseRuns(200);
+
+    enum Phase {
+        AddressResolution,
+        PeerConnection,
+        ObjectSetup,
+        Negotiation,
+        Total
+    };
+}
+
+void Bm_Connect::init()
+{
+    mClock = QSharedPointer<Maliit::InputContext::VirtualClock>(new Maliit::InputContext::VirtualClock);
+    mAddress = QSharedPointer<ManualAddress>(new ManualAddress);
+    mServer = QSharedPointer<FakeTransport>(new FakeTransport);
+}
+
+void Bm_Connect::cleanup()
+{
+    processEvents();
+    mServer.clear();
+    mAddress.clear();
+    mClock.clear();
+}
+
+void Bm_Connect::processEvents()
+{
+    QCoreApplication::processEvents();
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+QString Bm_Connect::serverAddress(bool known)
+{
+    // Servers stay known for the whole process; a new one makes every
+    // start negotiate features as on first boot
+    if (known)
+        return QString::fromLatin1(KnownServerAddress);
+    return QString::fromLatin1("fake:startup%1").arg(++serverSerial);
+}
+
+DBusServerConnection *Bm_Connect::startUp(const QString &serverAddress)
+{
+    // The address is resolved as soon as asked for, so the time is the
+    // library's own; the fake transport needs no socket
+    DBusServerConnection *connection = new DBusServerConnection(mAddress, mClock, QString(), mServer);
+    QSignalSpy connected(connection, SIGNAL(connected()));
+    mClock->advance(0);
+    mAddress->resolve(serverAddress);
+    processEvents();
+
+    if (connected.count() != 1) {
+        delete connection;
+        return 0;
+    }
+    return connection;
+}
+
+void Bm_Connect::benchmarkStartup_data()
+{
+    QTest::addColumn<bool>("known");
+    QTest::newRow("new server") << false;
+    QTest::newRow("known server") << true;
+}
+
+void Bm_Connect::benchmarkStartup()
+{
+    QFETCH(bool, known);
+    if (known) {
+        delete startUp(serverAddress(true));
+        processEvents();
+    }
+
+    QBENCHMARK {
+        DBusServerConnection *connection = startUp(serverAddress(known));
+        QVERIFY(connection);
+        delete connection;
+        processEvents();
+    }
+}
+
+void Bm_Connect::benchmarkStartupPhase_data()
+{
+    QTest::addColumn<bool>("known");
+    QTest::addColumn<int>("phase");
+
+    const char * const phaseNames[] = {
+        "address resolution", "peer connection", "object setup", "negotiation", "total"
+    };
+    for (int phase = AddressResolution; phase <= Total; ++phase) {
+        QTest::newRow(QByteArray("new server, ").append(phaseNames[phase]).constData()) << false << phase;
+    }
+    for (int phase = AddressResolution; phase <= Total; ++phase) {
+        QTest::newRow(QByteArray("known server, ").append(phaseNames[phase]).constData()) << true << phase;
+    }
+}
+
+void Bm_Connect::benchmarkStartupPhase()
+{
+    QFETCH(bool, known);
+    QFETCH(int, phase);
+
+    qint64 elapsed = 0;
+    for (int run = 0; run < PhaseRuns; ++run) {
+        DBusServerConnection *connection = startUp(serverAddress(known));
+        QVERIFY(connection);
+
+        const DBusServerConnection::ConnectTimings timings = connection->connectTimings();
+        switch (phase) {
+        case AddressResolution:
+            elapsed += timings.addressResolution;
+            break;
+        case PeerConnection:
+            elapsed += timings.peerConnection;
+            break;
+        case ObjectSetup:
+            elapsed += timings.objectSetup;
+            break;
+        case Negotiation:
+            elapsed += timings.negotiation;
+            break;
+        case Total:
+            elapsed += timings.total;
+            break;
+        }
+
+        delete connection;
+        processEvents();
+    }
+
+    // The timings are in µs
+    QTest::setBenchmarkResult(elapsed / 1000.0 / PhaseRuns, QTest::WalltimeMilliseconds);
+}
+
+QTEST_GUILESS_MAIN(Bm_Connect)
@@ -0,0 +1,53 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef BM_CONNECT_H
+#define BM_CONNECT_H
+
+#include <QObject>
+#include <QSharedPointer>
+
+class DBusServerConnection;
+class FakeTransport;
+class ManualAddress;
+
+namespace Maliit {
+namespace InputContext {
+class VirtualClock;
+}
+}
+
+class Bm_Connect : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void benchmarkStartup_data();
+    void benchmarkStartup();
+    void benchmarkStartupPhase_data();
+    void benchmarkStartupPhase();
+
+private:
+    void processEvents();
+    QString serverAddress(bool known);
+    DBusServerConnection *startUp(const QString &serverAddress);
+
+    QSharedPointer<Maliit::InputContext::VirtualClock> mClock;
+    QSharedPointer<ManualAddress> mAddress;
+    QSharedPointer<FakeTransport> mServer;
+};
+
+#endif // BM_CONNECT_H
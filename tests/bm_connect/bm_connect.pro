@@ -0,0 +1,9 @@
+include(../common.pri)
+
+TARGET = bm_connect
+
+HEADERS += \
+    bm_connect.h \
+
+SOURCES += \
+    bm_connect.cpp \
@@ -0,0 +1,165 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "bm_prioritylanes.h"
+
+#include "connectionclock.h"
+#include "dbusserverconnection.h"
+#include "faketransport.h"
+#include "manualaddress.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QSignalSpy>
+#include <QtTest>
+
+namespace {
+    const char * const ServerAddress("fake:lanes");
+    const char * const KeyMethod("processKeyEvent");
+    // A server busy enough to hold calls back, as on a loaded device
+    const int MaxInFlightCalls(4);
+    const int StateUpdates(32); // per burst, each with copy/paste and orientation
+    const int StateEntries(64);
+    const int MaxRounds(1000); // event loop passes until a key must have arrived
+    const int KeyLatencyRuns(100);
+
+    QMap<QString, QVariant> largeState()
+    {
+        QMap<QString, QVariant> state;
+        for (int i = 0; i < StateEntries; ++i) {
+            state.insert(QString::fromLatin1("entry%1").arg(i), QString(256, QLatin1Char('x')));
+        }
+        return state;
+    }
+}
+
+void Bm_PriorityLanes::init()
+{
+    mClock = QSharedPointer<Maliit::InputContext::VirtualClock>(new Maliit::InputContext::VirtualClock);
+    mAddress = QSharedPointer<ManualAddress>(new ManualAddress);
+    mServer = QSharedPointer<FakeTransport>(new FakeTransport);
+    mConnection = new DBusServerConnection(mAddress, mClock, QString(), mServer);
+
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+    mClock->advance(0);
+    mAddress->resolve(QString::fromLatin1(ServerAddress));
+    processEvents();
+    QCOMPARE(connected.count(), 1);
+
+    mConnection->setMaxInFlightCalls(MaxInFlightCalls);
+    mServer->setRecording(true);
+}
+
+void Bm_PriorityLanes::cleanup()
+{
+    delete mConnection;
+    mConnection = 0;
+    processEvents();
+    mServer.clear();
+    mAddress.clear();
+    mClock.clear();
+}
+
+void Bm_PriorityLanes::processEvents()
+{
+    QCoreApplication::processEvents();
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+void Bm_PriorityLanes::sendStateLoad()
+{
+    const QMap<QString, QVariant> state(largeState());
+    for (int i = 0; i < StateUpdates; ++i) {
+        mConnection->updateWidgetInformation(state, false);
+        mConnection->setCopyPasteState(i % 2, true);
+        mConnection->appOrientationChanged((i % 4) * 90);
+    }
+}
+
+void Bm_PriorityLanes::sendKey()
+{
+    mConnection->processKeyEvent(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, QString::fromLatin1("a"),
+                                 false, 1, 0, 0, 0);
+}
+
+int Bm_PriorityLanes::deliverKey()
+{
+    // Answers arrive from the event loop and let queued calls go; returns
+    // the number of messages the server got before the key
+    int ahead = 0;
+    for (int round = 0; round < MaxRounds; ++round) {
+        Q_FOREACH (const QDBusMessage &message, mServer->takeMessages()) {
+            if (message.member() == QLatin1String(KeyMethod))
+                return ahead;
+            ++ahead;
+        }
+        processEvents();
+    }
+    return -1;
+}
+
+void Bm_PriorityLanes::benchmarkMessagesAheadOfKey_data()
+{
+    QTest::addColumn<bool>("lanes");
+    QTest::newRow("priority lanes") << true;
+    QTest::newRow("single queue") << false;
+}
+
+void Bm_PriorityLanes::benchmarkMessagesAheadOfKey()
+{
+    QFETCH(bool, lanes);
+    mConnection->setPriorityLanesEnabled(lanes);
+    mServer->takeMessages();
+
+    sendStateLoad();
+    sendKey();
+    const int ahead = deliverKey();
+    QVERIFY(ahead >= 0);
+
+    QTest::setBenchmarkResult(ahead, QTest::Events);
+}
+
+void Bm_PriorityLanes::benchmarkKeyLatency_data()
+{
+    benchmarkMessagesAheadOfKey_data();
+}
+
+void Bm_PriorityLanes::benchmarkKeyLatency()
+{
+    QFETCH(bool, lanes);
+    mConnection->setPriorityLanesEnabled(lanes);
+
+    // From the key press until the server has it, the state burst before
+    // it is not part of the measurement
+    qint64 elapsed = 0;
+    QElapsedTimer timer;
+    for (int run = 0; run < KeyLatencyRuns; ++run) {
+        mServer->takeMessages();
+        sendStateLoad();
+
+        timer.start();
+        sendKey();
+        QVERIFY(deliverKey() >= 0);
+        elapsed += timer.nsecsElapsed();
+
+        // Everything else goes out before the next run
+        for (int round = 0; round < MaxRounds && mConnection->queueStatistics().inFlightCalls > 0; ++round) {
+            processEvents();
+        }
+    }
+
+    QTest::setBenchmarkResult(elapsed / 1000000.0 / KeyLatencyRuns, QTest::WalltimeMilliseconds);
+}
+
+QTEST_GUILESS_MAIN(Bm_PriorityLanes)
@@ -0,0 +1,9 @@
+include(../common.pri)
+
+TARGET = bm_prioritylanes
+
+HEADERS += \
+    bm_prioritylanes.h \
+
+SOURCES += \
+    bm_prioritylanes.cpp \
@@ -0,0 +1,49 @@
+# Builds the connection code of the input context straight into every test,
+# without the platform input context plugin around it.
+
+QT = core dbus testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+ICDIR = $$PWD/..
+UTILSDIR = $$PWD/utils
+
+INCLUDEPATH += $$ICDIR $$UTILSDIR
+DEPENDPATH += $$ICDIR $$UTILSDIR
+
+HEADERS += \
+    $$ICDIR/allocationstats.h \
+    $$ICDIR/completion.h \
+    $$ICDIR/connectionclock.h \
+    $$ICDIR/connectioncounters.h \
+    $$ICDIR/contextadaptor.h \
+    $$ICDIR/dbusserverconnection.h \
+    $$ICDIR/inputcontextdbusaddress.h \
+    $$ICDIR/inputcontextdbustransport.h \
+    $$ICDIR/mimserverconnection.h \
+    $$ICDIR/namespace.h \
+    $$ICDIR/pluginsettingscache.h \
+    $$ICDIR/serverproxy.h \
+    $$ICDIR/settingdata.h \
+    $$ICDIR/tracepoints.h \
+    $$ICDIR/tracing.h \
+    $$UTILSDIR/faketransport.h \
+    $$UTILSDIR/manualaddress.h \
+
+SOURCES += \
+    $$ICDIR/allocationstats.cpp \
+    $$ICDIR/completion.cpp \
+    $$ICDIR/connectionclock.cpp \
+    $$ICDIR/connectioncounters.cpp \
+    $$ICDIR/contextadaptor.cpp \
+    $$ICDIR/dbusserverconnection.cpp \
+    $$ICDIR/inputcontextdbusaddress.cpp \
+    $$ICDIR/inputcontextdbustransport.cpp \
+    $$ICDIR/mimserverconnection.cpp \
+    $$ICDIR/pluginsettingscache.cpp \
+    $$ICDIR/serverproxy.cpp \
+    $$ICDIR/settingdata.cpp \
+    $$ICDIR/tracepoints.cpp \
+    $$ICDIR/tracing.cpp \
+    $$UTILSDIR/faketransport.cpp \
+    $$UTILSDIR/manualaddress.cpp \
@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    bm_allocations \
+    bm_connect \
+    bm_prioritylanes \
+    ut_connectionrecovery \
@@ -0,0 +1,220 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "ut_connectionrecovery.h"
+
+#include "connectionclock.h"
+#include "dbusserverconnection.h"
+#include "faketransport.h"
+#include "manualaddress.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QSignalSpy>
+#include <QtTest>
+
+namespace {
+    const int RetryInterval(500); // in ms
+    int serverSerial(0);
+    const int ReconnectCycles(2000);
+}
+
+void Ut_ConnectionRecovery::init()
+{
+    mClock = QSharedPointer<Maliit::InputContext::VirtualClock>(new Maliit::InputContext::VirtualClock);
+    mAddress = QSharedPointer<ManualAddress>(new ManualAddress);
+    mServer = QSharedPointer<FakeTransport>(new FakeTransport);
+    // Servers stay known for the whole process, every test meets a new one
+    mServerAddress = QString::fromLatin1("fake:%1").arg(++serverSerial);
+    mConnection = new DBusServerConnection(mAddress, mClock, QString(), mServer);
+    mConnection->setConnectionRetryInterval(RetryInterval);
+}
+
+void Ut_ConnectionRecovery::cleanup()
+{
+    delete mConnection;
+    mConnection = 0;
+    processEvents();
+    mServer.clear();
+    mAddress.clear();
+    mClock.clear();
+}
+
+void Ut_ConnectionRecovery::processEvents()
+{
+    // Answers are delivered as queued calls, finished calls are deleted
+    // later; neither needs any waiting
+    QCoreApplication::processEvents();
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+void Ut_ConnectionRecovery::connectServer()
+{
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+
+    mClock->advance(0);
+    mAddress->resolve(mServerAddress);
+    processEvents();
+    QCOMPARE(connected.count(), 1);
+}
+
+void Ut_ConnectionRecovery::testFirstConnection()
+{
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+    QCOMPARE(mConnection->recoveryTime(), qint64(-1));
+
+    mClock->advance(0);
+    QCOMPARE(mAddress->pendingRequests(), 1);
+
+    mClock->advance(120);
+    mAddress->resolve(mServerAddress);
+    QCOMPARE(connected.count(), 0);
+    processEvents();
+    QCOMPARE(connected.count(), 1);
+
+    // Counted from construction
+    QCOMPARE(mConnection->recoveryTime(), qint64(120));
+    QCOMPARE(mServer->connects(), 1);
+    QCOMPARE(mClock->pending(), 0);
+}
+
+void Ut_ConnectionRecovery::testReconnection()
+{
+    connectServer();
+    QSignalSpy disconnected(mConnection, SIGNAL(disconnected()));
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+
+    mClock->advance(40);
+    mServer->dropClient();
+    QCOMPARE(disconnected.count(), 1);
+    processEvents();
+
+    mClock->advance(RetryInterval - 1);
+    QCOMPARE(mAddress->pendingRequests(), 0);
+    mClock->advance(1);
+    QCOMPARE(mAddress->pendingRequests(), 1);
+
+    // The known server is used right away, without waiting for the handshake
+    mAddress->resolve(mServerAddress);
+    QCOMPARE(connected.count(), 1);
+    QCOMPARE(mConnection->recoveryTime(), qint64(RetryInterval));
+}
+
+void Ut_ConnectionRecovery::testFailedAttempts()
+{
+    connectServer();
+    QSignalSpy disconnected(mConnection, SIGNAL(disconnected()));
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+
+    mServer->dropClient();
+    QCOMPARE(disconnected.count(), 1);
+
+    mClock->advance(RetryInterval);
+    mAddress->fail(QString::fromLatin1("no server"));
+    mClock->advance(RetryInterval);
+    QCOMPARE(mAddress->pendingRequests(), 1);
+
+    mClock->advance(200);
+    mAddress->resolve(mServerAddress);
+    QCOMPARE(connected.count(), 1);
+    QCOMPARE(mConnection->recoveryTime(), qint64(2 * RetryInterval + 200));
+}
+
+void Ut_ConnectionRecovery::testHandshakeTimeout()
+{
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+    mServer->setAnswersHandshake(false);
+
+    mClock->advance(0);
+    mAddress->resolve(mServerAddress);
+    QCOMPARE(mServer->pendingHandshakes(), 1);
+
+    mClock->advance(999);
+    processEvents();
+    QCOMPARE(connected.count(), 0);
+    mClock->advance(1);
+    QCOMPARE(connected.count(), 1);
+    QCOMPARE(mConnection->recoveryTime(), qint64(1000));
+
+    // The late answer still counts, but does not connect again
+    mServer->answerHandshakes();
+    processEvents();
+    QCOMPARE(connected.count(), 1);
+}
+
+void Ut_ConnectionRecovery::testHandshakeAnswered()
+{
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+    mServer->setAnswersHandshake(false);
+
+    mClock->advance(0);
+    mAddress->resolve(mServerAddress);
+    QCOMPARE(mServer->pendingHandshakes(), 1);
+
+    mClock->advance(300);
+    mServer->answerHandshakes();
+    QCOMPARE(connected.count(), 1);
+    QCOMPARE(mConnection->recoveryTime(), qint64(300));
+
+    // The handshake timeout is off the clock
+    QCOMPARE(mClock->pending(), 0);
+}
+
+void Ut_ConnectionRecovery::testUnreachableServer()
+{
+    connectServer();
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+
+    mServer->dropClient();
+    mServer->setReachable(false);
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        mClock->advance(RetryInterval);
+        mAddress->resolve(mServerAddress);
+    }
+    QCOMPARE(connected.count(), 0);
+    QCOMPARE(mServer->connects(), 1);
+
+    mServer->setReachable(true);
+    mClock->advance(RetryInterval);
+    mAddress->resolve(mServerAddress);
+    QCOMPARE(connected.count(), 1);
+    QCOMPARE(mServer->connects(), 2);
+    QCOMPARE(mConnection->recoveryTime(), qint64(4 * RetryInterval));
+}
+
+void Ut_ConnectionRecovery::testReconnectCycles()
+{
+    connectServer();
+    QSignalSpy disconnected(mConnection, SIGNAL(disconnected()));
+    QSignalSpy connected(mConnection, SIGNAL(connected()));
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int cycle = 1; cycle <= ReconnectCycles; ++cycle) {
+        mServer->dropClient();
+        mClock->advance(RetryInterval + cycle % 7);
+        mAddress->resolve(mServerAddress);
+        processEvents();
+
+        QCOMPARE(connected.count(), cycle);
+        QCOMPARE(mConnection->recoveryTime(), qint64(RetryInterval + cycle % 7));
+    }
+    qDebug() << ReconnectCycles << "reconnect cycles in" << timer.elapsed() << "ms";
+
+    QCOMPARE(disconnected.count(), ReconnectCycles);
+    QCOMPARE(mServer->connects(), ReconnectCycles + 1);
+    QVERIFY(mServer->isConnected());
+}
+
+QTEST_GUILESS_MAIN(Ut_ConnectionRecovery)
@@ -0,0 +1,58 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef UT_CONNECTIONRECOVERY_H
+#define UT_CONNECTIONRECOVERY_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+
+class DBusServerConnection;
+class FakeTransport;
+class ManualAddress;
+
+namespace Maliit {
+namespace InputContext {
+class VirtualClock;
+}
+}
+
+class Ut_ConnectionRecovery : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testFirstConnection();
+    void testReconnection();
+    void testFailedAttempts();
+    void testHandshakeTimeout();
+    void testHandshakeAnswered();
+    void testUnreachableServer();
+    void testReconnectCycles();
+
+private:
+    void processEvents();
+    void connectServer();
+
+    QSharedPointer<Maliit::InputContext::VirtualClock> mClock;
+    QSharedPointer<ManualAddress> mAddress;
+    QSharedPointer<FakeTransport> mServer;
+    QString mServerAddress;
+    DBusServerConnection *mConnection;
+};
+
+#endif // UT_CONNECTIONRECOVERY_H
@@ -0,0 +1,9 @@
+include(../common.pri)
+
+TARGET = ut_connectionrecovery
+
+HEADERS += \
+    ut_connectionrecovery.h \
+
+SOURCES += \
+    ut_connectionrecovery.cpp \
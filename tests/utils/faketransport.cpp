@@ -0,0 +1,221 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "faketransport.h"
+
+#include <QDBusPendingCall>
+#include <QDBusPendingCallWatcher>
+#include <QVariant>
+
+namespace {
+    const char * const NegotiateProtocolMethod("negotiateProtocol");
+    const uint ProtocolVersion(1);
+    const char * const ServerVersion("fake");
+}
+
+FakeTransport::FakeTransport()
+    : mReachable(true)
+    , mAnswersHandshake(true)
+    , mConnects(0)
+    , mCalls(0)
+    , mRecording(false)
+    , mMessages()
+    , mPeer()
+{
+}
+
+FakeTransport::~FakeTransport()
+{
+    // The client owns the peer, it only loses its server
+    if (mPeer) {
+        mPeer->drop();
+    }
+}
+
+void FakeTransport::setReachable(bool reachable)
+{
+    mReachable = reachable;
+}
+
+void FakeTransport::setAnswersHandshake(bool answers)
+{
+    mAnswersHandshake = answers;
+}
+
+void FakeTransport::answerHandshakes()
+{
+    if (mPeer) {
+        mPeer->answerHandshakes();
+    }
+}
+
+int FakeTransport::pendingHandshakes() const
+{
+    return mPeer ? mPeer->pendingHandshakes() : 0;
+}
+
+bool FakeTransport::isConnected() const
+{
+    return !mPeer.isNull();
+}
+
+int FakeTransport::connects() const
+{
+    return mConnects;
+}
+
+int FakeTransport::calls() const
+{
+    return mCalls;
+}
+
+void FakeTransport::setRecording(bool recording)
+{
+    mRecording = recording;
+    if (!recording) {
+        mMessages.clear();
+    }
+}
+
+QList<QDBusMessage> FakeTransport::takeMessages()
+{
+    QList<QDBusMessage> messages;
+    messages.swap(mMessages);
+    return messages;
+}
+
+void FakeTransport::dropClient()
+{
+    if (mPeer) {
+        FakePeer *peer = mPeer;
+        mPeer = 0;
+        peer->drop();
+    }
+}
+
+Maliit::InputContext::DBus::Peer *FakeTransport::connectToPeer(const QString &address, const QString &name)
+{
+    Q_UNUSED(address);
+    Q_UNUSED(name);
+
+    if (!mReachable)
+        return 0;
+
+    // One client at a time, as with the real server per seat
+    dropClient();
+    ++mConnects;
+    mPeer = new FakePeer(this);
+    return mPeer;
+}
+
+FakePeer::FakePeer(FakeTransport *transport)
+    : mTransport(transport)
+    , mHandshakes()
+{
+}
+
+FakePeer::~FakePeer()
+{
+    if (mTransport && mTransport->mPeer == this) {
+        mTransport->mPeer = 0;
+    }
+}
+
+bool FakePeer::registerObject(const QString &path, QObject *object)
+{
+    Q_UNUSED(path);
+    Q_UNUSED(object);
+    return mTransport != 0;
+}
+
+void FakePeer::send(const QDBusMessage &message)
+{
+    receive(message);
+}
+
+QDBusPendingCallWatcher *FakePeer::call(const QDBusMessage &message, QObject *parent)
+{
+    if (!mTransport) {
+        QDBusMessage error = message.createErrorReply(QDBusError::Disconnected, QString::fromLatin1("dropped"));
+        return new QDBusPendingCallWatcher(QDBusPendingCall::fromCompletedCall(error), parent);
+    }
+
+    receive(message);
+    if (message.member() == QLatin1String(NegotiateProtocolMethod) && !mTransport->mAnswersHandshake) {
+        // A call without reply never finishes, answerHandshakes() finishes
+        // it by hand
+        QDBusPendingCallWatcher *watcher
+            = new QDBusPendingCallWatcher(QDBusPendingCall::fromCompletedCall(QDBusMessage()), parent);
+        HeldCall held;
+        held.message = message;
+        held.watcher = watcher;
+        mHandshakes.append(held);
+        return watcher;
+    }
+
+    // Finished from the event loop, as real answers are
+    return new QDBusPendingCallWatcher(QDBusPendingCall::fromCompletedCall(answer(message)), parent);
+}
+
+void FakePeer::answerHandshakes()
+{
+    const QList<HeldCall> handshakes(mHandshakes);
+    mHandshakes.clear();
+    Q_FOREACH (const HeldCall &held, handshakes) {
+        // Late answers to a client that gave up on them are lost
+        if (!held.watcher)
+            continue;
+
+        QDBusPendingCall &call = *held.watcher;
+        call = QDBusPendingCall::fromCompletedCall(answer(held.message));
+        Q_EMIT held.watcher->finished(held.watcher);
+    }
+}
+
+int FakePeer::pendingHandshakes() const
+{
+    return mHandshakes.size();
+}
+
+void FakePeer::drop()
+{
+    if (!mTransport)
+        return;
+
+    mTransport = 0;
+    mHandshakes.clear();
+    Q_EMIT disconnected();
+}
+
+void FakePeer::receive(const QDBusMessage &message)
+{
+    if (!mTransport)
+        return;
+
+    ++mTransport->mCalls;
+    if (mTransport->mRecording) {
+        mTransport->mMessages.append(message);
+    }
+}
+
+QDBusMessage FakePeer::answer(const QDBusMessage &message) const
+{
+    if (message.member() != QLatin1String(NegotiateProtocolMethod))
+        return message.createReply();
+
+    const QList<QVariant> arguments(message.arguments());
+    return message.createReply(QList<QVariant>()
+                               << qMin(arguments.value(0).toUInt(), ProtocolVersion)
+                               << arguments.value(1).toUInt()
+                               << QString::fromLatin1(ServerVersion));
+}
@@ -0,0 +1,108 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_TESTS_FAKETRANSPORT_H
+#define MALIIT_INPUTCONTEXT_TESTS_FAKETRANSPORT_H
+
+#include "inputcontextdbustransport.h"
+
+#include <QDBusMessage>
+#include <QList>
+#include <QPointer>
+#include <QString>
+
+class FakePeer;
+
+/*! \brief Input method server reached without a socket, for tests.
+ *
+ * Every call is answered from within the client's own event loop, so
+ * connections come and go as fast as the test drives them.  Only the
+ * protocol handshake is implemented; it is answered right away unless
+ * told otherwise, other calls get an empty answer.
+ */
+class FakeTransport : public Maliit::InputContext::DBus::Transport
+{
+public:
+    FakeTransport();
+    ~FakeTransport();
+
+    //! \brief Whether connecting succeeds, true by default
+    void setReachable(bool reachable);
+    //! \brief Whether negotiateProtocol() is answered right away, true by default
+    void setAnswersHandshake(bool answers);
+    //! \brief Answers the handshakes held back so far
+    void answerHandshakes();
+    int pendingHandshakes() const;
+
+    bool isConnected() const;
+    //! \brief Connections opened so far
+    int connects() const;
+    //! \brief Calls and messages sent by the client so far, handshakes included
+    int calls() const;
+    //! \brief Whether the messages themselves are kept, false by default
+    void setRecording(bool recording);
+    //! \brief Messages kept since the last call, oldest first
+    QList<QDBusMessage> takeMessages();
+
+    //! \brief Closes the connection to the client, as a crashing server would
+    void dropClient();
+
+    //! reimpl
+    virtual Maliit::InputContext::DBus::Peer *connectToPeer(const QString &address, const QString &name);
+    //! reimpl end
+
+private:
+    friend class FakePeer;
+
+    bool mReachable;
+    bool mAnswersHandshake;
+    int mConnects;
+    int mCalls;
+    bool mRecording;
+    QList<QDBusMessage> mMessages;
+    QPointer<FakePeer> mPeer;
+};
+
+//! \brief Client end of a FakeTransport connection
+class FakePeer : public Maliit::InputContext::DBus::Peer
+{
+    Q_OBJECT
+
+public:
+    explicit FakePeer(FakeTransport *transport);
+    virtual ~FakePeer();
+
+    //! reimpl
+    virtual bool registerObject(const QString &path, QObject *object);
+    virtual void send(const QDBusMessage &message);
+    virtual QDBusPendingCallWatcher *call(const QDBusMessage &message, QObject *parent);
+    //! reimpl end
+
+    void answerHandshakes();
+    int pendingHandshakes() const;
+    void drop();
+
+private:
+    struct HeldCall {
+        QDBusMessage message;
+        QPointer<QDBusPendingCallWatcher> watcher;
+    };
+
+    QDBusMessage answer(const QDBusMessage &message) const;
+    void receive(const QDBusMessage &message);
+
+    FakeTransport *mTransport;
+    QList<HeldCall> mHandshakes;
+};
+
+#endif // MALIIT_INPUTCONTEXT_TESTS_FAKETRANSPORT_H
@@ -0,0 +1,49 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "manualaddress.h"
+
+ManualAddress::ManualAddress()
+    : mPendingRequests(0)
+{
+}
+
+void ManualAddress::get()
+{
+    ++mPendingRequests;
+}
+
+int ManualAddress::pendingRequests() const
+{
+    return mPendingRequests;
+}
+
+void ManualAddress::resolve(const QString &address)
+{
+    // Requests made while answering wait for the next answer
+    int requests = mPendingRequests;
+    mPendingRequests = 0;
+    for (; requests > 0; --requests) {
+        Q_EMIT addressReceived(address);
+    }
+}
+
+void ManualAddress::fail(const QString &errorMessage)
+{
+    // Requests made while answering wait for the next answer
+    int requests = mPendingRequests;
+    mPendingRequests = 0;
+    for (; requests > 0; --requests) {
+        Q_EMIT addressFetchError(errorMessage);
+    }
+}
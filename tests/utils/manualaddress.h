@@ -0,0 +1,40 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_TESTS_MANUALADDRESS_H
+#define MALIIT_INPUTCONTEXT_TESTS_MANUALADDRESS_H
+
+#include "inputcontextdbusaddress.h"
+
+/*! \brief Address answered by the caller, to drive connection attempts in tests.
+ *
+ * Requests are only counted by get(); resolve() and fail() answer all of
+ * them at once.
+ */
+class ManualAddress : public Maliit::InputContext::DBus::Address
+{
+    Q_OBJECT
+
+public:
+    ManualAddress();
+    void get();
+
+    int pendingRequests() const;
+    void resolve(const QString &address);
+    void fail(const QString &errorMessage);
+
+private:
+    int mPendingRequests;
+};
+
+#endif // MALIIT_INPUTCONTEXT_TESTS_MANUALADDRESS_H
@@ -0,0 +1,32 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "tracepoints.h"
+
+#ifdef MALIIT_ENABLE_SDT
+
+// Tracers increment these when attaching, they must live in .probes
+#define MALIIT_DEFINE_TRACEPOINT_SEMAPHORE(name) \
+    volatile unsigned short MALIIT_TRACEPOINT_SEMAPHORE(name) __attribute__((section(".probes"))) = 0
+
+extern "C" {
+MALIIT_DEFINE_TRACEPOINT_SEMAPHORE(connect);
+MALIIT_DEFINE_TRACEPOINT_SEMAPHORE(disconnect);
+MALIIT_DEFINE_TRACEPOINT_SEMAPHORE(reset_start);
+MALIIT_DEFINE_TRACEPOINT_SEMAPHORE(reset_finish);
+MALIIT_DEFINE_TRACEPOINT_SEMAPHORE(outgoing_call);
+MALIIT_DEFINE_TRACEPOINT_SEMAPHORE(incoming_dispatch);
+MALIIT_DEFINE_TRACEPOINT_SEMAPHORE(pending_resets_drop);
+}
+
+#endif // MALIIT_ENABLE_SDT
@@ -0,0 +1,77 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_TRACEPOINTS_H
+#define MALIIT_INPUTCONTEXT_TRACEPOINTS_H
+
+/* Statically defined tracepoints of provider "maliit", for perf, bpftrace
+ * and SystemTap.  Compiled in with MALIIT_ENABLE_SDT, which needs sys/sdt.h
+ * (systemtap-sdt-dev); otherwise the macros expand to nothing.
+ *
+ * Each tracepoint has a semaphore, so its arguments are only evaluated while
+ * a tracer is attached.  Timestamps are CLOCK_MONOTONIC microseconds, see
+ * Maliit::InputContext::Tracing::now().
+ *
+ *   connect(const char *address, int64 timestamp)
+ *   disconnect(int64 timestamp)
+ *   reset_start(void *call, int64 timestamp)
+ *   reset_finish(void *call, int64 timestamp)
+ *   outgoing_call(const char *method, int payloadSize, int64 timestamp)
+ *   incoming_dispatch(const char *method, int payloadSize, int64 timestamp)
+ *   pending_resets_drop(const char *method, int payloadSize, int64 timestamp)
+ *
+ * e.g. bpftrace -e 'usdt:libmaliit*:maliit:reset_start { @s[arg0] = arg1 }
+ *                   usdt:libmaliit*:maliit:reset_finish /@s[arg0]/ {
+ *                       @us = hist(arg1 - @s[arg0]); delete(@s[arg0]) }'
+ */
+
+#ifdef MALIIT_ENABLE_SDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#include "tracing.h"
+
+#define MALIIT_TRACEPOINT_SEMAPHORE(name) maliit_##name##_semaphore
+
+extern "C" {
+extern volatile unsigned short MALIIT_TRACEPOINT_SEMAPHORE(connect);
+extern volatile unsigned short MALIIT_TRACEPOINT_SEMAPHORE(disconnect);
+extern volatile unsigned short MALIIT_TRACEPOINT_SEMAPHORE(reset_start);
+extern volatile unsigned short MALIIT_TRACEPOINT_SEMAPHORE(reset_finish);
+extern volatile unsigned short MALIIT_TRACEPOINT_SEMAPHORE(outgoing_call);
+extern volatile unsigned short MALIIT_TRACEPOINT_SEMAPHORE(incoming_dispatch);
+extern volatile unsigned short MALIIT_TRACEPOINT_SEMAPHORE(pending_resets_drop);
+}
+
+#define MALIIT_TRACEPOINT_ENABLED(name) \
+    __builtin_expect(MALIIT_TRACEPOINT_SEMAPHORE(name) != 0, 0)
+
+#define MALIIT_TRACEPOINT1(name, a) \
+    do { if (MALIIT_TRACEPOINT_ENABLED(name)) DTRACE_PROBE1(maliit, name, a); } while (0)
+#define MALIIT_TRACEPOINT2(name, a, b) \
+    do { if (MALIIT_TRACEPOINT_ENABLED(name)) DTRACE_PROBE2(maliit, name, a, b); } while (0)
+#define MALIIT_TRACEPOINT3(name, a, b, c) \
+    do { if (MALIIT_TRACEPOINT_ENABLED(name)) DTRACE_PROBE3(maliit, name, a, b, c); } while (0)
+
+#define MALIIT_TRACEPOINT_NOW() (Maliit::InputContext::Tracing::now())
+
+#else
+
+#define MALIIT_TRACEPOINT1(name, a) do {} while (0)
+#define MALIIT_TRACEPOINT2(name, a, b) do {} while (0)
+#define MALIIT_TRACEPOINT3(name, a, b, c) do {} while (0)
+
+#endif // MALIIT_ENABLE_SDT
+
+#endif // MALIIT_INPUTCONTEXT_TRACEPOINTS_H
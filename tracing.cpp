@@ -0,0 +1,174 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#include "tracing.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#ifdef Q_OS_UNIX
+#include <time.h>
+#endif
+
+namespace
+{
+    const int MaxBufferedSpans(1 << 18);
+    const quint32 CompactFormatVersion(1);
+
+    struct Span
+    {
+        const char *name;
+        const char *category;
+        quint64 thread;
+        qint64 begin;
+        qint64 end;
+    };
+
+    QVector<Span> spans;
+    int droppedSpanCount = 0;
+    QBasicMutex spansMutex;
+
+    QByteArray jsonString(const char *string)
+    {
+        QByteArray result(string);
+        result.replace('\\', "\\\\").replace('"', "\\\"");
+        return '"' + result + '"';
+    }
+
+    QByteArray chromeJson(const QVector<Span> &spans)
+    {
+        const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+        QByteArray result("{\"traceEvents\":[");
+        for (int i = 0; i < spans.size(); ++i) {
+            const Span &span = spans.at(i);
+            if (i > 0)
+                result += ",\n";
+            result += "{\"name\":" + jsonString(span.name)
+                    + ",\"cat\":" + jsonString(span.category)
+                    + ",\"ph\":\"X\",\"ts\":" + QByteArray::number(span.begin)
+                    + ",\"dur\":" + QByteArray::number(span.end - span.begin)
+                    + ",\"pid\":" + pid
+                    + ",\"tid\":" + QByteArray::number(span.thread) + '}';
+        }
+        result += "],\"displayTimeUnit\":\"ms\"}\n";
+        return result;
+    }
+
+    QByteArray compactBinary(const QVector<Span> &spans)
+    {
+        // Names are string literals, so their addresses identify them
+        QHash<const char *, quint16> nameIndexes;
+        QList<const char *> names;
+        Q_FOREACH (const Span &span, spans) {
+            const char * const spanNames[] = { span.name, span.category };
+            for (int i = 0; i < 2; ++i) {
+                if (!nameIndexes.contains(spanNames[i])) {
+                    nameIndexes.insert(spanNames[i], names.size());
+                    names.append(spanNames[i]);
+                }
+            }
+        }
+
+        QByteArray result;
+        QDataStream stream(&result, QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+
+        stream.writeRawData("MLTR", 4);
+        stream << CompactFormatVersion << static_cast<quint32>(QCoreApplication::applicationPid());
+
+        stream << static_cast<quint32>(names.size());
+        Q_FOREACH (const char *name, names) {
+            const QByteArray bytes(name);
+            stream << static_cast<quint32>(bytes.size());
+            stream.writeRawData(bytes.constData(), bytes.size());
+        }
+
+        stream << static_cast<quint32>(spans.size());
+        Q_FOREACH (const Span &span, spans) {
+            stream << nameIndexes.value(span.name) << nameIndexes.value(span.category)
+                   << span.thread << span.begin << (span.end - span.begin);
+        }
+        return result;
+    }
+}
+
+namespace Maliit {
+namespace InputContext {
+namespace Tracing {
+
+QBasicAtomicInt enabledFlag = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+void setEnabled(bool enabled)
+{
+    enabledFlag.storeRelease(enabled ? 1 : 0);
+}
+
+qint64 now()
+{
+#ifdef Q_OS_UNIX
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return qint64(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+#else
+    static QElapsedTimer clock;
+    if (!clock.isValid())
+        clock.start();
+    return clock.msecsSinceReference() * 1000 + clock.nsecsElapsed() / 1000;
+#endif
+}
+
+void record(const char *name, const char *category, qint64 begin, qint64 end)
+{
+    const Span span = {
+        name,
+        category,
+        static_cast<quint64>(reinterpret_cast<quintptr>(QThread::currentThreadId())),
+        begin,
+        end
+    };
+
+    QMutexLocker locker(&spansMutex);
+    if (spans.size() >= MaxBufferedSpans) {
+        ++droppedSpanCount;
+        return;
+    }
+    spans.append(span);
+}
+
+QByteArray flush(Format format)
+{
+    QVector<Span> taken;
+    {
+        QMutexLocker locker(&spansMutex);
+        taken.swap(spans);
+        droppedSpanCount = 0;
+    }
+
+    return format == CompactBinaryFormat ? compactBinary(taken) : chromeJson(taken);
+}
+
+int droppedSpans()
+{
+    QMutexLocker locker(&spansMutex);
+    return droppedSpanCount;
+}
+
+} // namespace Tracing
+} // namespace InputContext
+} // namespace Maliit
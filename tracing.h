@@ -0,0 +1,99 @@
+/* * This file is part of Maliit framework *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * and appearing in the file LICENSE.LGPL included in the packaging
+ * of this file.
+ */
+
+/*
+ * Copyright 2013-2017 Myriad Group AG. All Rights Reserved.
+ */
+
+#ifndef MALIIT_INPUTCONTEXT_TRACING_H
+#define MALIIT_INPUTCONTEXT_TRACING_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+
+namespace Maliit {
+namespace InputContext {
+
+/*! \brief Timeline of the input pipeline, in Chrome trace event format.
+ *
+ * Off by default.  While enabled, spans are buffered in memory until
+ * flush() takes them; the buffer is bounded and spans beyond it are dropped.
+ * Timestamps are CLOCK_MONOTONIC microseconds, so the result lines up with
+ * traces the application records itself.
+ */
+namespace Tracing {
+
+enum Format {
+    ChromeJsonFormat,   //!< {"traceEvents": [...]}, loads in chrome://tracing and Perfetto
+    CompactBinaryFormat //!< see flush()
+};
+
+//! \internal read inline by TraceSpan, so disabled spans cost one load
+extern QBasicAtomicInt enabledFlag;
+
+inline bool enabled()
+{
+    return enabledFlag.loadAcquire() != 0;
+}
+
+void setEnabled(bool enabled);
+
+//! \brief Monotonic time in microseconds
+qint64 now();
+
+//! \brief Buffers a span of \a name that ran from \a begin to \a end, see now()
+void record(const char *name, const char *category, qint64 begin, qint64 end);
+
+/*! \brief Returns the buffered spans in \a format and clears the buffer.
+ *
+ * The compact binary format is little endian: the magic "MLTR", a quint32
+ * version (1) and the quint32 process id, a quint32 count of names followed
+ * by each name as a quint32 length and Latin-1 bytes, then a quint32 count
+ * of spans followed by each span as quint16 name and category indexes, the
+ * quint64 thread id, and qint64 start and duration in microseconds.
+ */
+QByteArray flush(Format format = ChromeJsonFormat);
+
+//! \brief Spans dropped because the buffer was full, since the last flush()
+int droppedSpans();
+
+} // namespace Tracing
+
+/*! \brief Records the lifetime of the scope as a span while tracing is on.
+ *
+ * \a name and \a category must outlive the process, string literals in
+ * practice.
+ */
+class TraceSpan
+{
+public:
+    TraceSpan(const char *name, const char *category)
+        : mName(name)
+        , mCategory(category)
+        , mBegin(Tracing::enabled() ? Tracing::now() : -1)
+    {}
+
+    ~TraceSpan()
+    {
+        if (mBegin >= 0)
+            Tracing::record(mName, mCategory, mBegin, Tracing::now());
+    }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    const char *mName;
+    const char *mCategory;
+    qint64 mBegin;
+};
+
+} // namespace InputContext
+} // namespace Maliit
+
+#endif // MALIIT_INPUTCONTEXT_TRACING_H